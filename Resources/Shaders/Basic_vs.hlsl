@@ -2,12 +2,14 @@ struct Input {
     float3 pos : POSITION0;
     float2 uv : TEXCOORD0;
     float3 normal : NORMAL0;
+    float2 light : TEXCOORD1; // sky, block in [0, 1]
 };
 
 struct Output {
     float4 pos : SV_POSITION;
     float2 uv : TEXCOORD0;
     float3 normal : NORMAL0;
+    float2 light : TEXCOORD1; // sky, block in [0, 1]
 };
 
 cbuffer ModelData : register(b0) {
@@ -27,6 +29,7 @@ Output main(Input input) {
     output.pos = mul(output.pos, Projection);
     output.uv = input.uv;
     output.normal = input.normal;
+    output.light = input.light;
     
 	return output;
 }
\ No newline at end of file
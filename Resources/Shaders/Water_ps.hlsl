@@ -2,6 +2,7 @@ struct Input {
     float4 pos : SV_POSITION;
     float2 uv : TEXCOORD0;
     float3 normal : NORMAL0;
+    float2 light : TEXCOORD1; // sky, block in [0, 1]
 };
 
 Texture2D tex : register(t0); // t0 reprsente le slot 0 de
@@ -12,6 +13,10 @@ float4 main(Input input) : SV_TARGET {
     
     float3 lightIntensity = float3(0.2,0.15,0.25); // ambient
     lightIntensity += saturate(dot(input.normal, float3(-1, -1, -1))) * float3(0.98, 0.87, 0.34); // diffuse
+    // each light level is 80% of the next one, the sun and the ambient only reach where the sky does
+    float sky = pow(0.8, 15 - 15 * input.light.x);
+    float block = pow(0.8, 15 - 15 * input.light.y);
+    lightIntensity = lightIntensity * sky + block * float3(1.0, 0.85, 0.6);
     res.rgb *= saturate(lightIntensity);
     
     return res;
@@ -6,18 +6,39 @@ template<typename TVertex>
 class VertexBuffer {
 	std::vector<TVertex> data;
 	ComPtr<ID3D11Buffer> buffer;
+	size_t gpuSize = 0; // vertices the device buffer can hold
 public:
 	uint32_t PushVertex(const TVertex& vtx) {
 		data.push_back(vtx);
 		return data.size() - 1;
 	}
+	TVertex& At(uint32_t index) { return data[index]; }
+	uint32_t Size() const { return (uint32_t)data.size(); }
+	const std::vector<TVertex>& GetData() const { return data; }
+	void Resize(uint32_t count) { data.resize(count); }
 
 	void Clear() {
 		data.clear();
 	}
 
+	// rewrites the device buffer in place when the data still fits, creates a bigger one otherwise
+	void Update(DeviceResources* deviceRes) {
+		UpdateRange(deviceRes, 0, (uint32_t)data.size());
+	}
+	// same for count vertices from first only
+	void UpdateRange(DeviceResources* deviceRes, uint32_t first, uint32_t count) {
+		if (data.empty() || count == 0) return;
+		if (!buffer || data.size() > gpuSize) {
+			Create(deviceRes);
+			return;
+		}
+		D3D11_BOX box = { (UINT)(sizeof(TVertex) * first), 0, 0, (UINT)(sizeof(TVertex) * (first + count)), 1, 1 };
+		deviceRes->GetD3DDeviceContext()->UpdateSubresource(buffer.Get(), 0, &box, data.data() + first, 0, 0);
+	}
+
 	void Create(DeviceResources* deviceRes) {
 		if (data.empty()) return;
+		gpuSize = data.size();
 		CD3D11_BUFFER_DESC desc(
 			sizeof(TVertex) * data.size(),
 			D3D11_BIND_VERTEX_BUFFER
@@ -43,12 +64,16 @@ public:
 class IndexBuffer {
 	std::vector<uint32_t> data;
 	ComPtr<ID3D11Buffer> buffer;
+	size_t gpuSize = 0; // indices the device buffer can hold
 public:
 	void PushTriangle(uint32_t a, uint32_t b, uint32_t c) {
 		data.push_back(a);
 		data.push_back(b);
 		data.push_back(c);
 	}
+	uint32_t& At(uint32_t index) { return data[index]; }
+	const std::vector<uint32_t>& GetData() const { return data; }
+	void Resize(uint32_t count) { data.resize(count); }
 
 	void Clear() {
 		data.clear();
@@ -58,8 +83,24 @@ public:
 		return (uint32_t)data.size();
 	}
 
+	// rewrites the device buffer in place when the data still fits, creates a bigger one otherwise
+	void Update(DeviceResources* deviceRes) {
+		UpdateRange(deviceRes, 0, (uint32_t)data.size());
+	}
+	// same for count indices from first only
+	void UpdateRange(DeviceResources* deviceRes, uint32_t first, uint32_t count) {
+		if (data.empty() || count == 0) return;
+		if (!buffer || data.size() > gpuSize) {
+			Create(deviceRes);
+			return;
+		}
+		D3D11_BOX box = { (UINT)(sizeof(uint32_t) * first), 0, 0, (UINT)(sizeof(uint32_t) * (first + count)), 1, 1 };
+		deviceRes->GetD3DDeviceContext()->UpdateSubresource(buffer.Get(), 0, &box, data.data() + first, 0, 0);
+	}
+
 	void Create(DeviceResources* deviceRes) {
 		if (data.empty()) return;
+		gpuSize = data.size();
 		CD3D11_BUFFER_DESC desc(
 			sizeof(uint32_t) * data.size(),
 			D3D11_BIND_INDEX_BUFFER
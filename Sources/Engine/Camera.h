@@ -33,6 +33,8 @@ public:
 	Vector3 Right() const { return Vector3::TransformNormal(Vector3::Right, view.Invert()); }
 	Vector3 Up() const { return Vector3::TransformNormal(Vector3::Up, view.Invert()); }
 	Matrix GetInverseViewMatrix() const { return view.Invert(); }
+	const Matrix& GetViewMatrix() const { return view; }
+	const Matrix& GetProjectionMatrix() const { return proj; }
 	const BoundingFrustum& GetBounds() const { return bounds; }
 
 	void Create(DeviceResources* deviceRes);
@@ -0,0 +1,190 @@
+#include "pch.h"
+
+#include "OcclusionBuffer.h"
+#include <xmmintrin.h>
+
+OcclusionBuffer::OcclusionBuffer() {
+	for (int level = 0; level < LEVELS; level++)
+		hiZ[level].assign((WIDTH >> level) * (HEIGHT >> level), 1.0f);
+}
+
+void OcclusionBuffer::Clear(const Matrix& viewProj) {
+	this->viewProj = viewProj;
+	std::fill(hiZ[0].begin(), hiZ[0].end(), 1.0f);
+}
+
+static Vector4 ClipCorner(const Vector3& boxMin, const Vector3& boxMax, int i, const Matrix& viewProj) {
+	Vector4 p(
+		(i & 1) ? boxMax.x : boxMin.x,
+		(i & 2) ? boxMax.y : boxMin.y,
+		(i & 4) ? boxMax.z : boxMin.z,
+		1.0f);
+	return Vector4::Transform(p, viewProj);
+}
+
+Vector3 OcclusionBuffer::ToScreen(const Vector4& clip) {
+	float invW = 1.0f / clip.w;
+	return Vector3(
+		(clip.x * invW * 0.5f + 0.5f) * WIDTH,
+		(0.5f - clip.y * invW * 0.5f) * HEIGHT,
+		clip.z * invW);
+}
+
+bool OcclusionBuffer::ProjectBox(const Vector3& boxMin, const Vector3& boxMax, Vector3 corners[8]) const {
+	for (int i = 0; i < 8; i++) {
+		Vector4 clip = ClipCorner(boxMin, boxMax, i, viewProj);
+		// near plane is z = 0 in clip space, in front of it w >= near > 0
+		if (clip.z < 0.0f) return false;
+		corners[i] = ToScreen(clip);
+	}
+	return true;
+}
+
+void OcclusionBuffer::RasterizeBox(const Vector3& boxMin, const Vector3& boxMax) {
+	Vector4 c[8];
+	for (int i = 0; i < 8; i++)
+		c[i] = ClipCorner(boxMin, boxMax, i, viewProj);
+
+	// corner index bits are (x, y, z)
+	static const int faces[6][4] = {
+		{ 0, 2, 6, 4 }, { 1, 5, 7, 3 }, // -x +x
+		{ 0, 4, 5, 1 }, { 2, 3, 7, 6 }, // -y +y
+		{ 0, 1, 3, 2 }, { 4, 6, 7, 5 }, // -z +z
+	};
+	for (auto& face : faces) {
+		// clip the quad against the near plane (z >= 0): a plane cuts a convex quad into at most 5 vertices
+		Vector4 clipped[5];
+		int count = 0;
+		for (int i = 0; i < 4; i++) {
+			const Vector4& a = c[face[i]];
+			const Vector4& b = c[face[(i + 1) & 3]];
+			if (a.z >= 0.0f) clipped[count++] = a;
+			if ((a.z >= 0.0f) != (b.z >= 0.0f)) {
+				// from the kept end, so the faces sharing the edge cut it at the same point
+				const Vector4& in = a.z >= 0.0f ? a : b;
+				const Vector4& out = a.z >= 0.0f ? b : a;
+				float t = in.z / (in.z - out.z);
+				clipped[count++] = Vector4(in.x + (out.x - in.x) * t, in.y + (out.y - in.y) * t, 0.0f, in.w + (out.w - in.w) * t);
+			}
+		}
+		if (count < 3) continue;
+
+		Vector3 screen[5];
+		for (int i = 0; i < count; i++)
+			screen[i] = ToScreen(clipped[i]);
+		for (int i = 1; i + 1 < count; i++)
+			RasterizeTriangle(screen[0], screen[i], screen[i + 1]);
+	}
+}
+
+void OcclusionBuffer::RasterizeTriangle(const Vector3& a, const Vector3& b, const Vector3& c) {
+	float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	if (std::abs(area) < 1e-6f) return;
+	// counter clockwise in pixels from here on, so inside is where every edge function is >= 0
+	if (area < 0) {
+		RasterizeTriangle(a, c, b);
+		return;
+	}
+	float invArea = 1.0f / area;
+
+	int minX = std::max(0, (int)std::floor(std::min({ a.x, b.x, c.x }))) & ~3;
+	int maxX = std::min(WIDTH - 1, (int)std::ceil(std::max({ a.x, b.x, c.x })));
+	int minY = std::max(0, (int)std::floor(std::min({ a.y, b.y, c.y })));
+	int maxY = std::min(HEIGHT - 1, (int)std::ceil(std::max({ a.y, b.y, c.y })));
+	if (minX > maxX || minY > maxY) return;
+
+	// E(p) = A * px + B * py + C, the weight of the opposite vertex times the area.
+	// Always evaluated from the same end of an edge: the two triangles sharing it get exactly opposite values and
+	// leave no crack between them
+	auto edge = [&](const Vector3& from, const Vector3& to, float& A, float& B, float& C) {
+		bool flip = to.x < from.x || (to.x == from.x && to.y < from.y);
+		const Vector3& p = flip ? to : from;
+		const Vector3& q = flip ? from : to;
+		A = -(q.y - p.y);
+		B = q.x - p.x;
+		C = -(A * p.x + B * p.y);
+		if (flip) {
+			A = -A;
+			B = -B;
+			C = -C;
+		}
+	};
+	float A0, B0, C0, A1, B1, C1, A2, B2, C2;
+	edge(b, c, A0, B0, C0);
+	edge(c, a, A1, B1, C1);
+	edge(a, b, A2, B2, C2);
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 za = _mm_set1_ps(a.z * invArea), zb = _mm_set1_ps(b.z * invArea), zc = _mm_set1_ps(c.z * invArea);
+	float* depth = hiZ[0].data();
+
+	for (int y = minY; y <= maxY; y++) {
+		float py = y + 0.5f;
+		__m128 row0 = _mm_set1_ps(B0 * py + C0);
+		__m128 row1 = _mm_set1_ps(B1 * py + C1);
+		__m128 row2 = _mm_set1_ps(B2 * py + C2);
+		for (int x = minX; x <= maxX; x += 4) {
+			__m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+			__m128 w0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A0), px), row0);
+			__m128 w1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A1), px), row1);
+			__m128 w2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A2), px), row2);
+			__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)), _mm_cmpge_ps(w2, zero));
+			if (_mm_movemask_ps(inside) == 0) continue;
+
+			__m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(za, w0), _mm_mul_ps(zb, w1)), _mm_mul_ps(zc, w2));
+			float* dst = depth + y * WIDTH + x;
+			__m128 current = _mm_loadu_ps(dst);
+			__m128 closest = _mm_min_ps(current, z);
+			_mm_storeu_ps(dst, _mm_or_ps(_mm_and_ps(inside, closest), _mm_andnot_ps(inside, current)));
+		}
+	}
+}
+
+void OcclusionBuffer::BuildHiZ() {
+	for (int level = 1; level < LEVELS; level++) {
+		const std::vector<float>& src = hiZ[level - 1];
+		std::vector<float>& dst = hiZ[level];
+		int srcWidth = WIDTH >> (level - 1);
+		int width = WIDTH >> level;
+		int height = HEIGHT >> level;
+		for (int y = 0; y < height; y++) {
+			const float* row0 = &src[(y * 2) * srcWidth];
+			const float* row1 = row0 + srcWidth;
+			for (int x = 0; x < width; x++)
+				dst[y * width + x] = std::max(std::max(row0[x * 2], row0[x * 2 + 1]), std::max(row1[x * 2], row1[x * 2 + 1]));
+		}
+	}
+}
+
+bool OcclusionBuffer::IsVisible(const Vector3& boxMin, const Vector3& boxMax) const {
+	Vector3 c[8];
+	if (!ProjectBox(boxMin, boxMax, c)) return true;
+
+	float minX = c[0].x, maxX = c[0].x, minY = c[0].y, maxY = c[0].y, minZ = c[0].z;
+	for (int i = 1; i < 8; i++) {
+		minX = std::min(minX, c[i].x);
+		maxX = std::max(maxX, c[i].x);
+		minY = std::min(minY, c[i].y);
+		maxY = std::max(maxY, c[i].y);
+		minZ = std::min(minZ, c[i].z);
+	}
+
+	int x0 = std::max(0, (int)std::floor(minX));
+	int x1 = std::min(WIDTH - 1, (int)std::ceil(maxX) - 1);
+	int y0 = std::max(0, (int)std::floor(minY));
+	int y1 = std::min(HEIGHT - 1, (int)std::ceil(maxY) - 1);
+	if (x0 > x1 || y0 > y1) return true;
+
+	// coarsest level where the rect covers at most 2x2 texels
+	int level = 0;
+	while (level < LEVELS - 1 && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+		level++;
+
+	const std::vector<float>& depth = hiZ[level];
+	int width = WIDTH >> level;
+	for (int y = y0 >> level; y <= (y1 >> level); y++)
+		for (int x = x0 >> level; x <= (x1 >> level); x++)
+			if (minZ <= depth[y * width + x]) return true;
+	return false;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <array>
+
+using namespace DirectX::SimpleMath;
+
+// Small CPU depth buffer: occluder boxes are rasterized into it (4 pixels at a time with SSE),
+// then a max-depth hierarchical Z answers "is this box hidden" with at most 2x2 texel reads.
+// Nothing here touches the GPU so it can run / be tested headless.
+class OcclusionBuffer {
+public:
+	constexpr static int WIDTH = 256;
+	constexpr static int HEIGHT = 128;
+	constexpr static int LEVELS = 8; // down to 2x1
+private:
+	std::array<std::vector<float>, LEVELS> hiZ; // level 0 is the depth buffer itself, 1 = far plane
+	Matrix viewProj;
+public:
+	OcclusionBuffer();
+
+	void Clear(const Matrix& viewProj);
+	// faces are clipped against the near plane, so a box around the camera still covers what it hides
+	void RasterizeBox(const Vector3& boxMin, const Vector3& boxMax);
+	void BuildHiZ();
+	// conservative: anything crossing the near plane or not fully behind the buffer is visible
+	bool IsVisible(const Vector3& boxMin, const Vector3& boxMax) const;
+
+	const std::vector<float>& GetDepth() const { return hiZ[0]; }
+private:
+	// projects the 8 corners to (pixel x, pixel y, depth), returns false if one is behind the near plane
+	bool ProjectBox(const Vector3& boxMin, const Vector3& boxMax, Vector3 corners[8]) const;
+	static Vector3 ToScreen(const Vector4& clip);
+	void RasterizeTriangle(const Vector3& a, const Vector3& b, const Vector3& c);
+};
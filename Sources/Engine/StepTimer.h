@@ -24,7 +24,8 @@ namespace DX
 			m_framesThisSecond(0),
 			m_qpcSecondCounter(0),
 			m_isFixedTimeStep(false),
-			m_targetElapsedTicks(TicksPerSecond / 60)
+			m_targetElapsedTicks(TicksPerSecond / 60),
+			m_maxUpdatesPerTick(0)
 		{
 			if (!QueryPerformanceFrequency(&m_qpcFrequency))
 			{
@@ -61,6 +62,13 @@ namespace DX
 		void SetTargetElapsedTicks(uint64_t targetElapsed) noexcept { m_targetElapsedTicks = targetElapsed; }
 		void SetTargetElapsedSeconds(double targetElapsed) noexcept { m_targetElapsedTicks = SecondsToTicks(targetElapsed); }
 
+		// Cap on the catch-up Update calls done by a single Tick in fixed timestep mode (0 = no cap).
+		// Past the cap the remaining backlog is dropped: the simulation slows down instead of spiraling.
+		void SetMaxUpdatesPerTick(uint32_t maxUpdates) noexcept { m_maxUpdatesPerTick = maxUpdates; }
+
+		// How far we are between the last fixed Update and the next one, in [0, 1). Used to interpolate rendering.
+		double GetInterpolationAlpha() const noexcept { return m_isFixedTimeStep ? static_cast<double>(m_leftOverTicks) / m_targetElapsedTicks : 1.0; }
+
 		// Integer format represents time using 10,000,000 ticks per second.
 		static constexpr uint64_t TicksPerSecond = 10000000;
 
@@ -131,12 +139,20 @@ namespace DX
 
 				m_leftOverTicks += timeDelta;
 
+				uint32_t updates = 0;
 				while (m_leftOverTicks >= m_targetElapsedTicks)
 				{
+					if (m_maxUpdatesPerTick != 0 && updates == m_maxUpdatesPerTick)
+					{
+						m_leftOverTicks %= m_targetElapsedTicks;
+						break;
+					}
+
 					m_elapsedTicks = m_targetElapsedTicks;
 					m_totalTicks += m_targetElapsedTicks;
 					m_leftOverTicks -= m_targetElapsedTicks;
 					m_frameCount++;
+					updates++;
 
 					update();
 				}
@@ -186,5 +202,6 @@ namespace DX
 		// Members for configuring fixed timestep mode.
 		bool m_isFixedTimeStep;
 		uint64_t m_targetElapsedTicks;
+		uint32_t m_maxUpdatesPerTick;
 	};
 }
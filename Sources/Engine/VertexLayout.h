@@ -83,3 +83,23 @@ struct VertexLayout_PositionNormalUV {
 		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
 	};
 };
+
+struct VertexLayout_PositionNormalUVLight {
+	// Constructor for ease of use
+	VertexLayout_PositionNormalUVLight() = default;
+	VertexLayout_PositionNormalUVLight(Vector3 const& pos, Vector3 const& normal, Vector2 const& uv, Vector2 const& light) noexcept : position(pos), normal(normal), uv(uv), light(light) {}
+
+	// The actual data inside the struct
+	Vector3 position;
+	Vector3 normal;
+	Vector2 uv;
+	Vector2 light; // sky, block in [0, 1]
+
+	// Input Layout Descriptor
+	static inline const std::vector<D3D11_INPUT_ELEMENT_DESC> InputElementDescs = {
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 1, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	};
+};
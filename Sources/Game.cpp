@@ -13,6 +13,9 @@
 #include "Minicraft/Cube.h"
 #include "Minicraft/World.h"
 #include "Minicraft/Player.h"
+#include "Minicraft/WorldSaver.h"
+#include "Minicraft/Entities.h"
+#include "Minicraft/Benchmarks.h"
 
 extern void ExitGame() noexcept;
 
@@ -27,12 +30,18 @@ Shader waterShader(L"water");
 Texture terrain(L"terrain");
 World world;
 Player player;
+WorldSaver saver;
+EntityStore entities;
 
 struct alignas(16) GlobalData {
 	Vector4 times;
 };
 ConstantBuffer<GlobalData> cbGlobal;
 
+// la simulation tourne a pas fixe, le rendu interpole entre les deux derniers ticks
+constexpr double SIMULATION_RATE = 60.0; // ticks / s
+constexpr uint32_t MAX_CATCHUP_TICKS = 4; // per rendered frame, past that the simulation slows down
+
 Shader lineShader(L"Line");
 VertexBuffer<VertexLayout_PositionColor> debugLine;
 
@@ -40,9 +49,17 @@ VertexBuffer<VertexLayout_PositionColor> debugLine;
 Game::Game() noexcept(false) {
 	m_deviceResources = std::make_unique<DeviceResources>(DXGI_FORMAT_B8G8R8A8_UNORM_SRGB, DXGI_FORMAT_D32_FLOAT, 2);
 	m_deviceResources->RegisterDeviceNotify(this);
+
+	m_timer.SetFixedTimeStep(true);
+	m_timer.SetTargetElapsedSeconds(1.0 / SIMULATION_RATE);
+	m_timer.SetMaxUpdatesPerTick(MAX_CATCHUP_TICKS);
 }
 
 Game::~Game() {
+	// flush-on-exit barrier: every edited chunk must be on disk before we quit
+	saver.Flush(world);
+	saver.Stop();
+
 	ImGui_ImplDX11_Shutdown();
 	ImGui_ImplWin32_Shutdown();
 	ImGui::DestroyContext();
@@ -74,12 +91,13 @@ void Game::Initialize(HWND window, int width, int height) {
 
 	m_commonStates = std::make_unique<CommonStates>(device);
 
-	GenerateInputLayout<VertexLayout_PositionNormalUV>(m_deviceResources.get(), &basicShader);
+	GenerateInputLayout<VertexLayout_PositionNormalUVLight>(m_deviceResources.get(), &basicShader);
 
 	lineShader.Create(m_deviceResources.get());
 	GenerateInputLayout<VertexLayout_PositionColor>(m_deviceResources.get(), &lineShader);
 
-	world.Generate();
+	saver.Open("Saves", world);
+	player.SetPosition(world.GetSpawnPosition());
 	world.CreateMesh(m_deviceResources.get());
 	terrain.Create(m_deviceResources.get());
 	cbGlobal.Create(m_deviceResources.get());
@@ -114,23 +132,46 @@ void Game::Initialize(HWND window, int width, int height) {
 	ImGui_ImplDX11_Init(m_deviceResources->GetD3DDevice(), m_deviceResources->GetD3DDeviceContext());
 }
 
+bool imGuiMode = false;
+
 void Game::Tick() {
-	ImGui_ImplDX11_NewFrame();
-	ImGui_ImplWin32_NewFrame();
-	ImGui::NewFrame();
+	// the input edges are found once per frame, the first tick after them consumes them
+	if (!imGuiMode)
+		player.UpdateInput(m_keyboard->GetState(), m_mouse->GetState());
 
 	// DX::StepTimer will compute the elapsed time and call Update() for us
-	// We pass Update as a callback to Tick() because StepTimer can be set to a "fixed time" step mode, allowing us to call Update multiple time in a row if the framerate is too low (useful for physics stuffs)
+	// It runs in fixed timestep mode: Update is called 0..MAX_CATCHUP_TICKS times per frame at SIMULATION_RATE,
+	// everything that must happen once per rendered frame (ImGui, mouse look, camera) lives in UpdateFrame
 	m_timer.Tick([&]() { Update(m_timer); });
 
+	// Don't try to render anything before the first Update, nor open an ImGui frame that wouldn't be rendered
+	if (m_timer.GetFrameCount() == 0)
+		return;
+
+	ImGui_ImplDX11_NewFrame();
+	ImGui_ImplWin32_NewFrame();
+	ImGui::NewFrame();
+	UpdateFrame();
+
 	Render();
 }
 
-bool imGuiMode = false;
-
-// Updates the world.
+// Updates the world, at a fixed rate.
 void Game::Update(DX::StepTimer const& timer) {
 	auto const kb = m_keyboard->GetState();
+
+	if (!imGuiMode)
+		player.Update(timer.GetElapsedSeconds(), kb);
+	world.Tick();
+	entities.Update(world, timer.GetElapsedSeconds());
+	saver.Update(world, timer.GetTotalSeconds());
+
+	auto const pad = m_gamePad->GetState(0);
+}
+
+// Once per rendered frame.
+void Game::UpdateFrame() {
+	auto const kb = m_keyboard->GetState();
 	auto const ms = m_mouse->GetState();
 
 	if (kb.P) imGuiMode = true;
@@ -139,24 +180,25 @@ void Game::Update(DX::StepTimer const& timer) {
 	if (imGuiMode) {
 		m_mouse->SetMode(Mouse::MODE_ABSOLUTE);
 
-		world.ShowImGui(m_deviceResources.get());
+		if (world.ShowImGui(m_deviceResources.get())) {
+			saver.NewWorld(world);
+			entities.Clear();
+			player.SetPosition(world.GetSpawnPosition());
+		}
+		saver.ShowImGui(world);
+		entities.ShowImGui();
+		ShowBenchmarksImGui(world);
 	} else {
 		m_mouse->SetMode(Mouse::MODE_RELATIVE);
-		player.Update(timer.GetElapsedSeconds(), kb, ms);
+		player.UpdateCamera(ms, (float)m_timer.GetInterpolationAlpha());
 	}
-	
+
 	if (kb.Escape)
 		ExitGame();
-
-	auto const pad = m_gamePad->GetState(0);
 }
 
 // Draws the scene.
 void Game::Render() {
-	// Don't try to render anything before the first Update.
-	if (m_timer.GetFrameCount() == 0)
-		return;
-
 	auto context = m_deviceResources->GetD3DDeviceContext();
 	auto renderTarget = m_deviceResources->GetRenderTargetView();
 	auto depthStencil = m_deviceResources->GetDepthStencilView();
@@ -169,10 +211,10 @@ void Game::Render() {
 	
 	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 	
-	ApplyInputLayout<VertexLayout_PositionNormalUV>(m_deviceResources.get());
+	ApplyInputLayout<VertexLayout_PositionNormalUVLight>(m_deviceResources.get());
 
 	cbGlobal.data.times = Vector4(
-		m_timer.GetTotalSeconds(), 0, 0, 0
+		m_timer.GetTotalSeconds() + m_timer.GetInterpolationAlpha() / SIMULATION_RATE, 0, 0, 0
 	);
 	cbGlobal.Update(m_deviceResources.get());
 	cbGlobal.ApplyToVS(m_deviceResources.get(), 2);
@@ -182,11 +224,20 @@ void Game::Render() {
 	terrain.Apply(m_deviceResources.get());
 	player.GetCamera().Apply(m_deviceResources.get());
 
+	world.Cull(&player.GetCamera());
 	context->OMSetBlendState(m_commonStates->Opaque(), NULL, 0xffffffff);
-	world.Draw(m_deviceResources.get(), &player.GetCamera(), ShaderPass::SP_OPAQUE);
+	world.Draw(m_deviceResources.get(), ShaderPass::SP_OPAQUE);
+
+	// horizon past the voxel world: plain colored triangles, the line shader does the job
+	world.GetHorizon().Update(player.GetCamera().GetPosition());
+	ApplyInputLayout<VertexLayout_PositionColor>(m_deviceResources.get());
+	lineShader.Apply(m_deviceResources.get());
+	world.GetHorizon().Draw(m_deviceResources.get());
+	ApplyInputLayout<VertexLayout_PositionNormalUVLight>(m_deviceResources.get());
+
 	context->OMSetBlendState(m_commonStates->AlphaBlend(), NULL, 0xffffffff);
 	waterShader.Apply(m_deviceResources.get());
-	world.Draw(m_deviceResources.get(), &player.GetCamera(), ShaderPass::SP_TRANSPARENT);
+	world.Draw(m_deviceResources.get(), ShaderPass::SP_TRANSPARENT);
 
 
 	context->OMSetBlendState(m_commonStates->Opaque(), NULL, 0xffffffff);
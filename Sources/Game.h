@@ -34,6 +34,7 @@ public:
 
 private:
 	void Update(DX::StepTimer const& timer);
+	void UpdateFrame();
 	void Render();
 
 	// Device resources.
@@ -0,0 +1,1118 @@
+#include "pch.h"
+
+#include "Benchmarks.h"
+#include "World.h"
+#include "Physics.h"
+#include "Player.h"
+#include "Entities.h"
+#include "SpatialIndex.h"
+#include "ChunkKernels.h"
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_set>
+
+using BenchClock = std::chrono::steady_clock;
+static volatile int benchSink; // keeps the optimizer from dropping the measured work
+
+static double SecondsSince(BenchClock::time_point start) {
+	return std::chrono::duration<double>(BenchClock::now() - start).count();
+}
+
+double BenchmarkCollisionQueries(World& world, int queries) {
+	const float GLOBAL_SIZE = (float)(World::WORLD_SIZE * Chunk::CHUNK_SIZE);
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> position(2.0f, GLOBAL_SIZE - 2.0f);
+	std::uniform_real_distribution<float> move(-2.0f, 2.0f);
+
+	// generate the inputs first so only MoveAndCollide is timed
+	std::vector<std::pair<AABB, Vector3>> inputs(queries);
+	for (auto& input : inputs) {
+		input.first = AABB::FromFeet(Vector3(position(rng), position(rng) * 0.25f, position(rng)), Player::HALF_WIDTH, Player::HEIGHT);
+		input.second = Vector3(move(rng), move(rng), move(rng));
+	}
+
+	int hits = 0;
+	auto start = BenchClock::now();
+	for (auto& input : inputs) {
+		AABB box = input.first;
+		CollisionResult result = MoveAndCollide(world, box, input.second);
+		hits += result.hitX || result.hitY || result.hitZ;
+	}
+	double elapsed = SecondsSince(start);
+	benchSink = hits;
+	return elapsed > 0 ? queries / elapsed : 0;
+}
+
+TickTiming BenchmarkEntities(World& world, int count, int ticks) {
+	const float GLOBAL_SIZE = (float)(World::WORLD_SIZE * Chunk::CHUNK_SIZE);
+	std::mt19937 rng(5678);
+	std::uniform_real_distribution<float> horizontal(1.0f, GLOBAL_SIZE - 1.0f);
+	std::uniform_real_distribution<float> altitude(GLOBAL_SIZE * 0.4f, GLOBAL_SIZE - 1.0f);
+	std::uniform_real_distribution<float> speed(-3.0f, 3.0f);
+
+	// the per chunk collision flags are lazy, don't time their first computation
+	for (int i = 0; i < World::WORLD_SIZE * World::WORLD_SIZE * World::WORLD_SIZE; i++)
+		world.GetChunkByIndex(i).HasCollision();
+
+	EntityStore entities;
+	entities.Reserve(count);
+	for (int i = 0; i < count; i++)
+		entities.Spawn(Vector3(horizontal(rng), altitude(rng), horizontal(rng)), Vector3(speed(rng), 0, speed(rng)), (BlockId)(1 + i % (COUNT - 1)));
+
+	TickTiming timing;
+	for (int t = 0; t < ticks; t++) {
+		entities.Update(world, 1.0f / 60.0f);
+		timing.avgMs += entities.GetStats().updateMs;
+		timing.maxMs = std::max(timing.maxMs, entities.GetStats().updateMs);
+	}
+	timing.avgMs /= std::max(1, ticks);
+	return timing;
+}
+
+BroadphaseRates BenchmarkBroadphase(int count, int queries) {
+	const float GLOBAL_SIZE = (float)(World::WORLD_SIZE * Chunk::CHUNK_SIZE);
+	std::mt19937 rng(91011);
+	std::uniform_real_distribution<float> position(0.0f, GLOBAL_SIZE);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	// never ticked: the moves go through the store so its positions and the index agree for the queries
+	EntityStore entities;
+	entities.Reserve(count);
+	std::vector<Vector3> spawns(count);
+	for (int i = 0; i < count; i++) {
+		spawns[i] = Vector3(position(rng), position(rng), position(rng));
+		entities.Spawn(spawns[i], Vector3::Zero, STONE);
+	}
+
+	BroadphaseRates rates;
+	std::vector<Vector3> points(queries), dirs(queries);
+	for (int q = 0; q < queries; q++) {
+		points[q] = Vector3(position(rng), position(rng), position(rng));
+		dirs[q] = Vector3(unit(rng), unit(rng), unit(rng));
+		dirs[q].Normalize();
+	}
+	EntityId results[256];
+	int hits = 0;
+
+	// every entity jumps somewhere else and back: the worst case, each move changes cell
+	auto start = BenchClock::now();
+	for (int i = 0; i < count; i++)
+		entities.SetPosition(i, points[i % queries]);
+	for (int i = 0; i < count; i++)
+		entities.SetPosition(i, spawns[i]);
+	rates.movesPerSecond = 2.0 * count / SecondsSince(start);
+
+	start = BenchClock::now();
+	for (int q = 0; q < queries; q++)
+		hits += entities.QueryRadius(points[q], 4.0f, results, 256);
+	rates.radiusQueriesPerSecond = queries / SecondsSince(start);
+
+	start = BenchClock::now();
+	for (int q = 0; q < queries; q++)
+		hits += entities.QueryAABB({ points[q] - Vector3(4.0f), points[q] + Vector3(4.0f) }, results, 256);
+	rates.aabbQueriesPerSecond = queries / SecondsSince(start);
+
+	start = BenchClock::now();
+	SpatialIndex::RayHit hit;
+	for (int q = 0; q < queries; q++)
+		hits += entities.Raycast(points[q], dirs[q], 32.0f, hit);
+	rates.raysPerSecond = queries / SecondsSince(start);
+
+	rates.hitsPerQuery = hits / (3.0 * queries);
+	return rates;
+}
+
+// the live world keeps its save and its edits, the block tick benchmarks happen in a copy
+static std::unique_ptr<World> CreateScratchWorld(World& world) {
+	auto scratch = std::make_unique<World>();
+	scratch->GetGenParams() = world.GetGenParams();
+	scratch->Generate();
+	return scratch;
+}
+
+// the same with every chunk meshed and its face records allocated, for the benchmarks that patch meshes
+static std::unique_ptr<World> CreateMeshedScratchWorld(World& world) {
+	auto scratch = CreateScratchWorld(world);
+	for (int i = 0; i < World::WORLD_SIZE * World::WORLD_SIZE * World::WORLD_SIZE; i++) {
+		Chunk& chunk = scratch->GetChunkByIndex(i);
+		chunk.AllocateFaceRecords();
+		chunk.UpdateMesh();
+	}
+	return scratch;
+}
+
+// one of the 6 square 90 degree views of a cube map around eye, face in Chunk::Face order
+static BoundingFrustum GetCubeMapFrustum(const Vector3& eye, int face) {
+	const Vector3 directions[6] = { Vector3::Left, Vector3::Right, Vector3::Down, Vector3::Up, Vector3::Forward, Vector3::Backward };
+	const Vector3& dir = directions[face];
+	Vector3 up = fabsf(dir.y) > 0.5f ? Vector3::Forward : Vector3::Up;
+	BoundingFrustum frustum;
+	BoundingFrustum::CreateFromMatrix(frustum, Matrix::CreatePerspectiveFieldOfView(XM_PIDIV2, 1.0f, 0.01f, 500.0f), true);
+	frustum.Transform(frustum, Matrix::CreateLookAt(eye, eye + dir, up).Invert());
+	return frustum;
+}
+
+static BlockTickTiming RunBlockTicks(World& world) {
+	BlockTickTiming timing;
+	BlockTicks& ticks = world.GetBlockTicks();
+	for (int t = 0; t < 100000 && ticks.GetPendingCount() > 0; t++) {
+		world.Tick();
+		const BlockTicks::Stats& stats = ticks.GetStats();
+		if (stats.processed == 0) continue;
+		timing.steps++;
+		timing.maxActive = std::max(timing.maxActive, stats.processed);
+		timing.written += stats.written;
+		timing.dirtyChunks += stats.dirtyChunks;
+		timing.avgMs += stats.stepMs;
+		timing.maxMs = std::max(timing.maxMs, stats.stepMs);
+	}
+	timing.avgMs /= std::max(1, timing.steps);
+	return timing;
+}
+
+BlockTickTiming BenchmarkFlood(World& world, int size) {
+	const int GLOBAL_SIZE = World::WORLD_SIZE * Chunk::CHUNK_SIZE;
+	auto scratch = CreateScratchWorld(world);
+
+	// stone box: the cavity, its ceiling, a one block deep lake of sources, then a cap
+	int x0 = (GLOBAL_SIZE - size) / 2, z0 = x0, y0 = 8;
+	int ceiling = y0 + size;
+	for (int z = z0 - 1; z <= z0 + size; z++) {
+		for (int y = y0 - 1; y <= ceiling + 2; y++) {
+			for (int x = x0 - 1; x <= x0 + size; x++) {
+				bool inside = x >= x0 && x < x0 + size && z >= z0 && z < z0 + size && y >= y0;
+				BlockId id = STONE;
+				if (inside && y < ceiling) id = EMPTY;
+				if (inside && y == ceiling + 1) id = WATER;
+				*scratch->GetCube(x, y, z) = id;
+			}
+		}
+	}
+
+	std::vector<BlockEdit> opening;
+	for (int z = z0; z < z0 + size; z++)
+		for (int x = x0; x < x0 + size; x++)
+			opening.push_back({ x, ceiling, z, EMPTY });
+	scratch->ApplyEdits(opening);
+	return RunBlockTicks(*scratch);
+}
+
+BlockTickTiming BenchmarkSandPillars(World& world, int grid) {
+	const int GLOBAL_SIZE = World::WORLD_SIZE * Chunk::CHUNK_SIZE;
+	const int PILLAR_HEIGHT = 64;
+	const int DROP = 16;
+	auto scratch = CreateScratchWorld(world);
+
+	// a stone floor, then DROP blocks of air under the stone block holding each pillar, one block between pillars
+	int x0 = (GLOBAL_SIZE - grid * 2) / 2, z0 = x0, floorY = 8;
+	int stilt = floorY + DROP + 1;
+	std::vector<BlockEdit> undermine;
+	for (int z = z0; z < z0 + grid * 2; z++) {
+		for (int x = x0; x < x0 + grid * 2; x++) {
+			bool pillar = (x - x0) % 2 == 0 && (z - z0) % 2 == 0;
+			for (int y = floorY; y <= stilt + PILLAR_HEIGHT; y++) {
+				BlockId id = EMPTY;
+				if (y == floorY) id = STONE;
+				else if (pillar && y == stilt) id = STONE;
+				else if (pillar && y > stilt && y <= stilt + PILLAR_HEIGHT) id = (y % 3) ? SAND : GRAVEL;
+				*scratch->GetCube(x, y, z) = id;
+			}
+			if (pillar) undermine.push_back({ x, stilt, z, EMPTY });
+		}
+	}
+
+	scratch->ApplyEdits(undermine);
+	return RunBlockTicks(*scratch);
+}
+
+ExplosionTiming BenchmarkTnt(World& world, int side) {
+	const int GLOBAL_SIZE = World::WORLD_SIZE * Chunk::CHUNK_SIZE;
+	auto scratch = CreateScratchWorld(world);
+
+	// buried in the bottom of the world so the blasts have stone to chew
+	int origin = (GLOBAL_SIZE - side) / 2, bottom = 8;
+	for (int z = 0; z < side; z++)
+		for (int y = 0; y < side; y++)
+			for (int x = 0; x < side; x++)
+				*scratch->GetCube(origin + x, bottom + y, origin + z) = TNT;
+	// the generated world starts all dirty: only what the explosions dirty is timed
+	for (int i = 0; i < World::WORLD_SIZE * World::WORLD_SIZE * World::WORLD_SIZE; i++)
+		scratch->GetChunkByIndex(i).ClearDirty();
+
+	ExplosionTiming timing;
+	Explosions& explosions = scratch->GetExplosions();
+	explosions.Ignite(*scratch, origin + side / 2, bottom + side / 2, origin + side / 2);
+	auto start = BenchClock::now();
+	while (explosions.GetPendingCount() > 0) {
+		scratch->Tick();
+		timing.ticks++;
+	}
+	timing.detonated = explosions.GetStats().totalDetonated;
+	timing.removed = explosions.GetStats().totalRemoved;
+	timing.simulationMs = SecondsSince(start) * 1000.0;
+
+	start = BenchClock::now();
+	for (int i = 0; i < World::WORLD_SIZE * World::WORLD_SIZE * World::WORLD_SIZE; i++) {
+		Chunk& chunk = scratch->GetChunkByIndex(i);
+		if (!chunk.NeedsMeshUpdate()) continue;
+		chunk.UpdateMesh();
+		timing.remeshed++;
+	}
+	timing.meshMs = SecondsSince(start) * 1000.0;
+	return timing;
+}
+
+BlockStateMemory MeasureBlockStateMemory(World& world) {
+	const int CHUNK_COUNT = World::WORLD_SIZE * World::WORLD_SIZE * World::WORLD_SIZE;
+	BlockStateMemory memory;
+	size_t total = 0;
+	for (int i = 0; i < CHUNK_COUNT; i++) {
+		Chunk& chunk = world.GetChunkByIndex(i);
+		total += chunk.GetStateMemory();
+		memory.statefulChunks += chunk.GetStateCount() > 0;
+	}
+	memory.typicalBytes = total / (double)CHUNK_COUNT;
+
+	auto heavy = std::make_unique<Chunk>();
+	std::mt19937 rng(1213);
+	for (int z = 0; z < Chunk::CHUNK_SIZE; z++)
+		for (int y = 0; y < Chunk::CHUNK_SIZE; y++)
+			for (int x = 0; x < Chunk::CHUNK_SIZE; x++)
+				heavy->SetState(x, y, z, (BlockState)(1 + rng() % (BS_LIT | BS_FACING_MASK)));
+	memory.heavyBytes = heavy->GetStateMemory();
+	memory.denseBytes = Chunk::CHUNK_SIZE * Chunk::CHUNK_SIZE * Chunk::CHUNK_SIZE * sizeof(BlockState);
+	return memory;
+}
+
+LightingTiming BenchmarkLighting(World& world, int edits) {
+	const int GLOBAL_SIZE = World::WORLD_SIZE * Chunk::CHUNK_SIZE;
+	auto scratch = CreateScratchWorld(world);
+	Lighting& lighting = scratch->GetLighting();
+
+	LightingTiming timing;
+	scratch->ComputeLighting();
+	timing.initialMs = lighting.GetStats().initialMs;
+	timing.threads = lighting.GetStats().threads;
+
+	std::mt19937 rng(777);
+	std::uniform_int_distribution<int> coord(0, GLOBAL_SIZE - 1);
+	double cells = 0;
+	auto record = [&]() {
+		const Lighting::Stats& stats = lighting.GetStats();
+		timing.updates++;
+		timing.avgMs += stats.lastMs;
+		timing.maxMs = std::max(timing.maxMs, stats.lastMs);
+		cells += stats.lastCells;
+	};
+	for (int i = 0; i < edits; i++) {
+		int x = coord(rng), z = coord(rng);
+		int y = GLOBAL_SIZE - 1;
+		while (y > 0 && *scratch->ReadCube(x, y, z) == EMPTY) y--;
+		switch (i % 3) {
+		case 0: // dig
+			scratch->SetCube(x, y, z, EMPTY);
+			record();
+			break;
+		case 1: // build
+			if (y + 1 >= GLOBAL_SIZE) break;
+			scratch->SetCube(x, y + 1, z, STONE);
+			record();
+			break;
+		case 2: // torch
+			if (y + 1 >= GLOBAL_SIZE) break;
+			scratch->SetCube(x, y + 1, z, FURNACE);
+			record();
+			scratch->SetState(x, y + 1, z, BS_LIT);
+			record();
+			break;
+		}
+	}
+	timing.avgMs /= std::max(1, timing.updates);
+	timing.avgCells = cells / std::max(1, timing.updates);
+
+	std::vector<uint8_t> incremental;
+	incremental.reserve(GLOBAL_SIZE * GLOBAL_SIZE * GLOBAL_SIZE);
+	for (int z = 0; z < GLOBAL_SIZE; z++)
+		for (int y = 0; y < GLOBAL_SIZE; y++)
+			for (int x = 0; x < GLOBAL_SIZE; x++)
+				incremental.push_back(*scratch->GetLight(x, y, z));
+	scratch->ComputeLighting();
+	size_t i = 0;
+	for (int z = 0; z < GLOBAL_SIZE; z++)
+		for (int y = 0; y < GLOBAL_SIZE; y++)
+			for (int x = 0; x < GLOBAL_SIZE; x++)
+				timing.mismatches += incremental[i++] != *scratch->GetLight(x, y, z);
+	return timing;
+}
+
+HeightmapTiming BenchmarkHeightmaps(World& world, int queries, int edits) {
+	const int GLOBAL_SIZE = World::WORLD_SIZE * Chunk::CHUNK_SIZE;
+	HeightmapTiming timing;
+	std::mt19937 rng(31);
+	std::uniform_int_distribution<int> coord(0, GLOBAL_SIZE - 1);
+
+	std::vector<int> columns(queries * 2);
+	for (int& c : columns) c = coord(rng);
+	int sum = 0;
+	auto start = BenchClock::now();
+	for (int i = 0; i < queries; i++)
+		sum += world.GetSolidHeight(columns[i * 2], columns[i * 2 + 1]) + world.GetLightBlockingHeight(columns[i * 2], columns[i * 2 + 1]);
+	timing.queriesPerSecond = queries / SecondsSince(start);
+
+	start = BenchClock::now();
+	for (int i = 0; i < queries; i++) {
+		int y = GLOBAL_SIZE - 1;
+		while (y >= 0 && *world.ReadCube(columns[i * 2], y, columns[i * 2 + 1]) == EMPTY) y--;
+		sum += y;
+	}
+	timing.scanQueriesPerSecond = queries / SecondsSince(start);
+	benchSink = sum;
+
+	// digs down the columns and builds towers, so the tops go both ways
+	auto scratch = CreateScratchWorld(world);
+	BlockId placed[] = { STONE, WATER, GLASS, DIRT };
+	start = BenchClock::now();
+	for (int i = 0; i < edits; i++) {
+		int x = coord(rng), z = coord(rng);
+		int top = std::max(scratch->GetSolidHeight(x, z), scratch->GetLightBlockingHeight(x, z));
+		if (rng() % 2 && top >= 0)
+			scratch->SetCube(x, top, z, EMPTY);
+		else if (top + 1 < GLOBAL_SIZE)
+			scratch->SetCube(x, top + 1, z, placed[rng() % 4]);
+	}
+	timing.editsPerSecond = edits / SecondsSince(start);
+	timing.mismatches = scratch->CheckHeightmaps();
+	return timing;
+}
+
+LodReport BenchmarkLod(World& world) {
+	const int CHUNK_COUNT = World::WORLD_SIZE * World::WORLD_SIZE * World::WORLD_SIZE;
+	auto scratch = CreateScratchWorld(world);
+	LodMeshes& lod = scratch->GetLod();
+	LodReport report;
+
+	auto start = BenchClock::now();
+	for (int i = 0; i < CHUNK_COUNT; i++) {
+		Chunk& chunk = scratch->GetChunkByIndex(i);
+		chunk.BuildMesh();
+		chunk.ClearDirty();
+		report.worldTriangles[0] += chunk.GetTriangleCount();
+	}
+	report.chunkMeshMs = SecondsSince(start) * 1000.0;
+
+	start = BenchClock::now();
+	lod.BuildMeshes();
+	report.lodMeshMs = SecondsSince(start) * 1000.0;
+	for (int level = 1; level <= LodMeshes::LEVEL_COUNT; level++)
+		report.worldTriangles[level] = lod.GetTriangleCount(level);
+
+	Vector3 eye = scratch->GetSpawnPosition() + Vector3(0, Player::HEIGHT, 0);
+	std::vector<Chunk*> chunks;
+	for (int face = 0; face < Chunk::FACE_COUNT; face++) {
+		BoundingFrustum frustum = GetCubeMapFrustum(eye, face);
+		chunks.clear();
+		for (int i = 0; i < CHUNK_COUNT; i++)
+			if (frustum.Intersects(scratch->GetChunkByIndex(i).GetBounds())) chunks.push_back(&scratch->GetChunkByIndex(i));
+		lod.Select(eye, frustum, chunks);
+		const LodMeshes::Stats& stats = lod.GetStats();
+		for (int level = 0; level <= LodMeshes::LEVEL_COUNT; level++)
+			report.nodes[level] += stats.nodes[level];
+		report.fullTriangles += stats.fullTriangles;
+		report.lodTriangles += stats.triangles;
+	}
+	return report;
+}
+
+HorizonTiming BenchmarkHorizon(World& world, int steps) {
+	const int GLOBAL_SIZE = World::WORLD_SIZE * Chunk::CHUNK_SIZE;
+	Horizon horizon;
+	horizon.Reset(world.GetGenParams(), GLOBAL_SIZE);
+	HorizonTiming timing;
+	Vector3 camera(GLOBAL_SIZE / 2.0f, 40.0f, GLOBAL_SIZE / 2.0f);
+	horizon.Update(camera);
+	horizon.BuildMesh();
+
+	double sampled = 0;
+	for (int i = 0; i < steps; i++) {
+		camera += (i < steps / 2) ? Vector3(1, 0, 0) : Vector3(0, 0, 1);
+		auto start = BenchClock::now();
+		sampled += horizon.Update(camera);
+		horizon.BuildMesh();
+		double ms = SecondsSince(start) * 1000.0;
+		timing.avgMs += ms;
+		timing.maxMs = std::max(timing.maxMs, ms);
+	}
+	timing.steps = steps;
+	timing.avgSampled = sampled / std::max(1, steps);
+	timing.avgMs /= std::max(1, steps);
+	timing.mismatches = horizon.Verify();
+	timing.memory = horizon.GetMemory();
+	timing.radius = Horizon::GRID / 2 * Horizon::GetCellSize(Horizon::LEVEL_COUNT - 1);
+	timing.chunkMemory = (size_t)(timing.radius * 2) * (timing.radius * 2) * GLOBAL_SIZE * sizeof(BlockId);
+	return timing;
+}
+
+MeshPatchTiming BenchmarkMeshPatch(World& world, int edits) {
+	const int GLOBAL_SIZE = World::WORLD_SIZE * Chunk::CHUNK_SIZE;
+	const int CHUNK_COUNT = World::WORLD_SIZE * World::WORLD_SIZE * World::WORLD_SIZE;
+	auto scratch = CreateMeshedScratchWorld(world);
+
+	std::mt19937 rng(4404);
+	std::uniform_int_distribution<int> coord(0, GLOBAL_SIZE - 1);
+	BlockId placed[] = { STONE, WATER, GLASS, DIRT };
+	MeshPatchTiming timing;
+	std::vector<Chunk*> touched;
+	for (int i = 0; i < edits; i++) {
+		// surface digs and builds, the relight dirties the faces around too
+		int x = coord(rng), z = coord(rng);
+		int top = std::max(scratch->GetSolidHeight(x, z), scratch->GetLightBlockingHeight(x, z));
+		if (rng() % 2 && top >= 0)
+			scratch->SetCube(x, top, z, EMPTY);
+		else if (top + 1 < GLOBAL_SIZE)
+			scratch->SetCube(x, top + 1, z, placed[rng() % 4]);
+
+		touched.clear();
+		for (int c = 0; c < CHUNK_COUNT; c++) {
+			Chunk& chunk = scratch->GetChunkByIndex(c);
+			if (!chunk.NeedsMeshUpdate()) continue;
+			touched.push_back(&chunk);
+			timing.rebuilt += chunk.IsDirty();
+		}
+		auto start = BenchClock::now();
+		for (Chunk* chunk : touched)
+			chunk->UpdateMesh();
+		double ms = SecondsSince(start) * 1000.0;
+		timing.patchMs += ms;
+		timing.maxPatchMs = std::max(timing.maxPatchMs, ms);
+		timing.avgChunks += touched.size();
+
+		std::vector<uint64_t> hashes;
+		for (Chunk* chunk : touched)
+			hashes.push_back(chunk->HashFaces());
+		start = BenchClock::now();
+		for (Chunk* chunk : touched)
+			chunk->BuildMesh();
+		timing.rebuildMs += SecondsSince(start) * 1000.0;
+		for (size_t c = 0; c < touched.size(); c++)
+			timing.mismatches += touched[c]->HashFaces() != hashes[c];
+	}
+	timing.edits = edits;
+	timing.avgChunks /= std::max(1, edits);
+	timing.patchMs /= std::max(1, edits);
+	timing.rebuildMs /= std::max(1, edits);
+	return timing;
+}
+
+DirtyPropagationReport BenchmarkDirtyPropagation(World& world) {
+	const int GLOBAL_SIZE = World::WORLD_SIZE * Chunk::CHUNK_SIZE;
+	const int CHUNK_COUNT = World::WORLD_SIZE * World::WORLD_SIZE * World::WORLD_SIZE;
+	const int BORDER = GLOBAL_SIZE / 2; // first x of a chunk
+	auto scratch = CreateMeshedScratchWorld(world);
+
+	// everything along the x border between two chunk columns: a tunnel dug under the surface, its walls turned
+	// from stone to dirt and back, then a glass wall built in the air over the border and taken down again
+	std::vector<BlockEdit> script;
+	for (int z = 1; z < GLOBAL_SIZE - 1; z++) {
+		int y = scratch->GetSolidHeight(BORDER - 1, z) - 3;
+		if (y > 0) script.push_back({ BORDER - 1, y, z, EMPTY });
+	}
+	for (BlockId id : { DIRT, STONE }) {
+		for (int z = 1; z < GLOBAL_SIZE - 1; z++) {
+			int y = scratch->GetSolidHeight(BORDER, z) - 3;
+			if (y > 0 && BlockTables::IsOpaque(*scratch->ReadCube(BORDER, y, z))) script.push_back({ BORDER, y, z, id });
+		}
+	}
+	for (BlockId id : { GLASS, EMPTY }) {
+		for (int z = 1; z < GLOBAL_SIZE - 1; z++) {
+			int y = std::max(scratch->GetSolidHeight(BORDER - 1, z), scratch->GetSolidHeight(BORDER, z)) + 3;
+			if (y < GLOBAL_SIZE) script.push_back({ BORDER - 1 + z % 2, y, z, id });
+		}
+	}
+
+	DirtyPropagationReport report;
+	for (const BlockEdit& edit : script) {
+		// marking the chunk of each of the 7 cubes dirtied the cube's chunk and every chunk across its borders
+		int lx = Chunk::Dims::ToLocal(edit.gx), ly = Chunk::Dims::ToLocal(edit.gy), lz = Chunk::Dims::ToLocal(edit.gz);
+		report.borderChunks++;
+		for (int face = 0; face < Chunk::FACE_COUNT; face++) {
+			int nx = edit.gx + Chunk::FACE_DIRS[face][0], ny = edit.gy + Chunk::FACE_DIRS[face][1], nz = edit.gz + Chunk::FACE_DIRS[face][2];
+			if (!scratch->ReadCube(nx, ny, nz)) continue;
+			int nlx = lx + Chunk::FACE_DIRS[face][0], nly = ly + Chunk::FACE_DIRS[face][1], nlz = lz + Chunk::FACE_DIRS[face][2];
+			bool across = nlx < 0 || nly < 0 || nlz < 0 || nlx >= Chunk::CHUNK_SIZE || nly >= Chunk::CHUNK_SIZE || nlz >= Chunk::CHUNK_SIZE;
+			report.borderChunks += across;
+		}
+
+		report.markedChunks += scratch->ApplyEdits({ edit });
+		auto start = BenchClock::now();
+		for (int i = 0; i < CHUNK_COUNT; i++) {
+			Chunk& chunk = scratch->GetChunkByIndex(i);
+			if (!chunk.NeedsMeshUpdate()) continue;
+			report.remeshedChunks++;
+			report.voxels += chunk.GetPendingVoxels();
+			chunk.UpdateMesh();
+		}
+		report.meshMs += SecondsSince(start) * 1000.0;
+	}
+	report.edits = (int)script.size();
+	return report;
+}
+
+BrickReport BenchmarkBricks(World& world, int edits) {
+	const int GLOBAL_SIZE = World::WORLD_SIZE * Chunk::CHUNK_SIZE;
+	const int CHUNK_COUNT = World::WORLD_SIZE * World::WORLD_SIZE * World::WORLD_SIZE;
+	auto scratch = CreateMeshedScratchWorld(world);
+	// every batch once, from its first brick
+	auto updateBatches = [&]() {
+		for (int c = 0; c < CHUNK_COUNT; c++) {
+			int cx, cy, cz;
+			World::GetChunkCoords(c, cx, cy, cz);
+			if (ChunkBatch::GetBrickIndex(cx, cy, cz) == 0) scratch->GetBatch(cx, cy, cz).UpdateMesh();
+		}
+	};
+	updateBatches();
+	BrickReport report;
+	for (int i = 0; i < CHUNK_COUNT; i++)
+		report.emptyBricks += scratch->GetChunkByIndex(i).IsEmpty();
+
+	// the 6 views of a cube map from the spawn point, cave and frustum culled
+	Vector3 eye = scratch->GetSpawnPosition() + Vector3(0, Player::HEIGHT, 0);
+	std::vector<Chunk*> chunks;
+	std::vector<std::pair<ChunkBatch*, ChunkBatch::BrickMask>> batches;
+	World::CullStats cullStats;
+	for (int face = 0; face < Chunk::FACE_COUNT; face++) {
+		scratch->CollectVisibleChunks(eye, GetCubeMapFrustum(eye, face), true, chunks, cullStats);
+		for (Chunk* chunk : chunks)
+			report.chunkDrawCalls += !chunk->GetIndices(SP_OPAQUE).empty();
+		scratch->GroupBatches(chunks, batches);
+		for (auto& [batch, visible] : batches)
+			report.batchDrawCalls += batch->PlanDraws(visible);
+	}
+
+	// edit to mesh: the bricks alone as they were drawn before, then the copy into their batch ranges
+	std::mt19937 rng(4606);
+	std::uniform_int_distribution<int> coord(0, GLOBAL_SIZE - 1);
+	BlockId placed[] = { STONE, GLASS, DIRT };
+	std::vector<Chunk*> touched;
+	for (int i = 0; i < edits; i++) {
+		int x = coord(rng), z = coord(rng);
+		int top = scratch->GetSolidHeight(x, z);
+		if (rng() % 2 && top >= 0)
+			scratch->SetCube(x, top, z, EMPTY);
+		else if (top + 1 < GLOBAL_SIZE)
+			scratch->SetCube(x, top + 1, z, placed[rng() % 3]);
+
+		touched.clear();
+		for (int c = 0; c < CHUNK_COUNT; c++)
+			if (scratch->GetChunkByIndex(c).NeedsMeshUpdate()) touched.push_back(&scratch->GetChunkByIndex(c));
+		auto start = BenchClock::now();
+		for (Chunk* chunk : touched)
+			chunk->UpdateMesh();
+		report.brickMs += SecondsSince(start) * 1000.0;
+		start = BenchClock::now();
+		updateBatches();
+		report.batchMs += SecondsSince(start) * 1000.0;
+	}
+	for (int c = 0; c < CHUNK_COUNT; c++) {
+		int cx, cy, cz;
+		World::GetChunkCoords(c, cx, cy, cz);
+		if (ChunkBatch::GetBrickIndex(cx, cy, cz) != 0) continue;
+		const ChunkBatch::Stats& stats = scratch->GetBatch(cx, cy, cz).GetStats();
+		report.relayouts += stats.relayouts - 1; // the first layout isn't an edit
+		report.brickWrites += stats.brickWrites;
+	}
+	report.edits = edits;
+	report.brickMs /= std::max(1, edits);
+	report.batchMs /= std::max(1, edits);
+	return report;
+}
+
+// the world cut in chunks of SIDE^3: generation, random lookups and face meshing of every chunk
+template<int SIDE>
+static ChunkSizeTiming MeasureChunkSize(const WorldGenParams& params, int lookups) {
+	using Dims = ChunkDims<SIDE>;
+	const int GLOBAL_SIZE = World::WORLD_SIZE * Chunk::CHUNK_SIZE;
+	const int COUNT = GLOBAL_SIZE / SIDE;
+	WorldGenerator generator(params);
+	std::vector<typename Dims::Data> chunks(COUNT * COUNT * COUNT);
+	auto getChunk = [&](int cx, int cy, int cz) -> typename Dims::Data& { return chunks[cx + cy * COUNT + cz * COUNT * COUNT]; };
+	auto getCube = [&](int gx, int gy, int gz) -> const BlockId* {
+		if ((unsigned)gx >= (unsigned)GLOBAL_SIZE || (unsigned)gy >= (unsigned)GLOBAL_SIZE || (unsigned)gz >= (unsigned)GLOBAL_SIZE) return nullptr;
+		return &getChunk(Dims::ToChunk(gx), Dims::ToChunk(gy), Dims::ToChunk(gz))[Dims::Index(Dims::ToLocal(gx), Dims::ToLocal(gy), Dims::ToLocal(gz))];
+	};
+
+	ChunkSizeTiming timing;
+	timing.side = SIDE;
+	timing.chunks = (int)chunks.size();
+	auto start = BenchClock::now();
+	for (int cz = 0; cz < COUNT; cz++)
+		for (int cy = 0; cy < COUNT; cy++)
+			for (int cx = 0; cx < COUNT; cx++)
+				generator.GenerateChunk<Dims>(cx, cy, cz, getChunk(cx, cy, cz));
+	timing.generateMs = SecondsSince(start) * 1000.0;
+
+	std::mt19937 rng(4707);
+	std::uniform_int_distribution<int> coord(0, GLOBAL_SIZE - 1);
+	std::vector<int> cells(lookups * 3);
+	for (int& c : cells) c = coord(rng);
+	int sum = 0;
+	start = BenchClock::now();
+	for (int i = 0; i < lookups; i++)
+		sum += *getCube(cells[i * 3], cells[i * 3 + 1], cells[i * 3 + 2]);
+	timing.lookupsPerSecond = lookups / SecondsSince(start);
+	benchSink = sum;
+
+	// the quads of the visible faces, what a chunk mesh costs before textures and light
+	std::vector<Vector3> vertices;
+	start = BenchClock::now();
+	for (int cz = 0; cz < COUNT; cz++) {
+		for (int cy = 0; cy < COUNT; cy++) {
+			for (int cx = 0; cx < COUNT; cx++) {
+				vertices.clear();
+				auto outside = [&](int lx, int ly, int lz) { return getCube(cx * SIDE + lx, cy * SIDE + ly, cz * SIDE + lz); };
+				int faces = ChunkKernels<Dims>::Mesh(getChunk(cx, cy, cz), outside, [&](int lx, int ly, int lz, uint8_t visible) {
+					for (int face = 0; face < Chunk::FACE_COUNT; face++) {
+						if (!(visible & (1 << face))) continue;
+						Vector3 center(lx + 0.5f, ly + 0.5f, lz + 0.5f);
+						Vector3 normal((float)Chunk::FACE_DIRS[face][0], (float)Chunk::FACE_DIRS[face][1], (float)Chunk::FACE_DIRS[face][2]);
+						for (int corner = 0; corner < 4; corner++)
+							vertices.push_back(center + normal * 0.5f + Vector3((float)(corner & 1), (float)(corner >> 1), 0) * 0.5f);
+					}
+				});
+				timing.faces += faces;
+				timing.meshedChunks += faces > 0;
+			}
+		}
+	}
+	timing.meshMs = SecondsSince(start) * 1000.0;
+	// an edit remeshes (at least) its whole chunk
+	timing.chunkMeshUs = timing.meshMs * 1000.0 / std::max(1, timing.meshedChunks);
+	return timing;
+}
+
+std::array<ChunkSizeTiming, 3> BenchmarkChunkSizes(World& world, int lookups) {
+	return { MeasureChunkSize<8>(world.GetGenParams(), lookups), MeasureChunkSize<16>(world.GetGenParams(), lookups),
+		MeasureChunkSize<32>(world.GetGenParams(), lookups) };
+}
+
+// the world in chunks of Dims ordered by Grid: face meshing, a sky light flood and raycasts
+template<class Dims, class Grid>
+static VoxelLayoutTiming MeasureVoxelLayout(const char* name, const WorldGenParams& params, int rays) {
+	constexpr int GLOBAL_SIZE = World::WORLD_SIZE * Chunk::CHUNK_SIZE;
+	constexpr int COUNT = Grid::SIZE;
+	static_assert(COUNT * Dims::SIZE == GLOBAL_SIZE, "the layouts cut the same world");
+	WorldGenerator generator(params);
+	std::vector<typename Dims::Data> chunks(Grid::VOLUME);
+	std::vector<std::array<uint8_t, Dims::VOLUME>> light(Grid::VOLUME);
+	auto isInside = [](int gx, int gy, int gz) {
+		return (unsigned)gx < (unsigned)GLOBAL_SIZE && (unsigned)gy < (unsigned)GLOBAL_SIZE && (unsigned)gz < (unsigned)GLOBAL_SIZE;
+	};
+	auto getChunkIndex = [](int gx, int gy, int gz) { return Grid::Index(Dims::ToChunk(gx), Dims::ToChunk(gy), Dims::ToChunk(gz)); };
+	auto getLocalIndex = [](int gx, int gy, int gz) { return Dims::Index(Dims::ToLocal(gx), Dims::ToLocal(gy), Dims::ToLocal(gz)); };
+	auto getCube = [&](int gx, int gy, int gz) -> const BlockId* {
+		if (!isInside(gx, gy, gz)) return nullptr;
+		return &chunks[getChunkIndex(gx, gy, gz)][getLocalIndex(gx, gy, gz)];
+	};
+	for (int chunk = 0; chunk < Grid::VOLUME; chunk++)
+		generator.GenerateChunk<Dims>(Grid::IndexX(chunk), Grid::IndexY(chunk), Grid::IndexZ(chunk), chunks[chunk]);
+
+	VoxelLayoutTiming timing;
+	timing.name = name;
+	auto start = BenchClock::now();
+	for (int chunk = 0; chunk < Grid::VOLUME; chunk++) {
+		const int ox = Grid::IndexX(chunk) * Dims::SIZE, oy = Grid::IndexY(chunk) * Dims::SIZE, oz = Grid::IndexZ(chunk) * Dims::SIZE;
+		auto outside = [&](int lx, int ly, int lz) { return getCube(ox + lx, oy + ly, oz + lz); };
+		timing.faces += ChunkKernels<Dims>::Mesh(chunks[chunk], outside, [](int, int, int, uint8_t) {});
+	}
+	timing.meshMs = SecondsSince(start) * 1000.0;
+
+	// 15 from the top of every column, kept going straight down, one less per step to the sides and up
+	std::vector<int> queue;
+	queue.reserve(GLOBAL_SIZE * GLOBAL_SIZE * 4);
+	auto pack = [](int gx, int gy, int gz) { return gx | gy << 8 | gz << 16; };
+	start = BenchClock::now();
+	for (int gz = 0; gz < GLOBAL_SIZE; gz++) {
+		for (int gx = 0; gx < GLOBAL_SIZE; gx++) {
+			const int gy = GLOBAL_SIZE - 1;
+			if (BlockTables::IsOpaque(*getCube(gx, gy, gz))) continue;
+			light[getChunkIndex(gx, gy, gz)][getLocalIndex(gx, gy, gz)] = 15;
+			queue.push_back(pack(gx, gy, gz));
+		}
+	}
+	for (size_t head = 0; head < queue.size(); head++) {
+		const int gx = queue[head] & 0xff, gy = (queue[head] >> 8) & 0xff, gz = queue[head] >> 16;
+		const int level = light[getChunkIndex(gx, gy, gz)][getLocalIndex(gx, gy, gz)];
+		for (int face = 0; face < Chunk::FACE_COUNT; face++) {
+			const int nx = gx + Chunk::FACE_DIRS[face][0], ny = gy + Chunk::FACE_DIRS[face][1], nz = gz + Chunk::FACE_DIRS[face][2];
+			const int next = face == Chunk::FACE_NEG_Y && level == 15 ? 15 : level - 1;
+			if (next <= 0 || !isInside(nx, ny, nz)) continue;
+			const int chunk = getChunkIndex(nx, ny, nz), local = getLocalIndex(nx, ny, nz);
+			if (light[chunk][local] >= next || BlockTables::IsOpaque(chunks[chunk][local])) continue;
+			light[chunk][local] = (uint8_t)next;
+			queue.push_back(pack(nx, ny, nz));
+		}
+	}
+	timing.lightMs = SecondsSince(start) * 1000.0;
+	for (const auto& cells : light)
+		for (uint8_t level : cells) timing.litCells += level > 0;
+
+	// grid traversal from random points in random directions, 64 blocks at most
+	std::mt19937 rng(4808);
+	std::uniform_real_distribution<float> coord(0.0f, (float)GLOBAL_SIZE);
+	std::normal_distribution<float> axis;
+	std::vector<std::pair<Vector3, Vector3>> rayList(rays);
+	for (auto& ray : rayList) {
+		ray.first = Vector3(coord(rng), coord(rng), coord(rng));
+		ray.second = Vector3(axis(rng), axis(rng), axis(rng));
+		ray.second.Normalize();
+	}
+	start = BenchClock::now();
+	for (const auto& ray : rayList) {
+		int cell[3] = { (int)ray.first.x, (int)ray.first.y, (int)ray.first.z };
+		const float origin[3] = { ray.first.x, ray.first.y, ray.first.z }, dir[3] = { ray.second.x, ray.second.y, ray.second.z };
+		int step[3];
+		float tMax[3], tDelta[3];
+		for (int i = 0; i < 3; i++) {
+			step[i] = dir[i] < 0 ? -1 : 1;
+			tDelta[i] = dir[i] != 0 ? std::abs(1.0f / dir[i]) : FLT_MAX;
+			const float boundary = dir[i] < 0 ? (float)cell[i] : (float)(cell[i] + 1);
+			tMax[i] = dir[i] != 0 ? (boundary - origin[i]) / dir[i] : FLT_MAX;
+		}
+		for (float t = 0; t <= 64.0f;) {
+			const BlockId* cube = getCube(cell[0], cell[1], cell[2]);
+			if (!cube) break;
+			if (BlockTables::IsOpaque(*cube)) {
+				timing.rayHits++;
+				break;
+			}
+			const int i = tMax[0] < tMax[1] ? (tMax[0] < tMax[2] ? 0 : 2) : (tMax[1] < tMax[2] ? 1 : 2);
+			t = tMax[i];
+			tMax[i] += tDelta[i];
+			cell[i] += step[i];
+		}
+	}
+	timing.raysPerSecond = rays / SecondsSince(start);
+	return timing;
+}
+
+std::array<VoxelLayoutTiming, 2> BenchmarkVoxelLayout(World& world, int rays) {
+	return { MeasureVoxelLayout<ChunkDims<8>, ChunkDims<World::WORLD_SIZE>>("linear", world.GetGenParams(), rays),
+		MeasureVoxelLayout<ChunkDims<8, MortonLayout>, ChunkDims<World::WORLD_SIZE, MortonLayout>>("morton", world.GetGenParams(), rays) };
+}
+
+SnapshotStress BenchmarkSnapshots(World& world, int readers, int rounds) {
+	struct Handout {
+		Chunk::Snapshot blocks;
+		uint64_t hash;
+	};
+	auto hashBlocks = [](const Chunk::Data& data) {
+		uint64_t hash = 14695981039346656037ull;
+		for (BlockId id : data)
+			hash = (hash ^ id) * 1099511628211ull;
+		return hash;
+	};
+	auto scratch = CreateScratchWorld(world);
+	const int liveBefore = ChunkVersion<Chunk::Dims>::live.load();
+	int clonesBefore = 0;
+	for (int i = 0; i < World::WORLD_SIZE * World::WORLD_SIZE * World::WORLD_SIZE; i++)
+		clonesBefore += scratch->GetChunkByIndex(i).GetCloneCount();
+
+	SnapshotStress stress;
+	stress.readers = readers;
+	stress.rounds = rounds;
+	std::mutex mutex;
+	std::vector<Handout> mailbox;
+	std::atomic<bool> done = false;
+	std::atomic<int> reads = 0, mismatches = 0;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < readers; t++) {
+		threads.emplace_back([&] {
+			std::vector<Handout> taken;
+			while (true) {
+				bool finished;
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					// read before taking: every handout posted before done was set is in the mailbox by now
+					finished = done;
+					for (int i = 0; i < 7 && !mailbox.empty(); i++) {
+						taken.push_back(std::move(mailbox.back()));
+						mailbox.pop_back();
+					}
+				}
+				if (taken.empty()) {
+					if (finished) break;
+					std::this_thread::yield();
+					continue;
+				}
+				// several passes while the writer keeps going, then the versions are dropped on this thread
+				for (const Handout& handout : taken) {
+					for (int pass = 0; pass < 4; pass++) {
+						if (hashBlocks(handout.blocks.GetData()) != handout.hash) mismatches++;
+						reads++;
+					}
+				}
+				taken.clear();
+			}
+		});
+	}
+
+	std::mt19937 rng(5050);
+	std::uniform_int_distribution<int> chunkCoord(1, World::WORLD_SIZE - 2);
+	std::uniform_int_distribution<int> offset(-Chunk::CHUNK_SIZE, 2 * Chunk::CHUNK_SIZE - 1);
+	const BlockId palette[] = { EMPTY, STONE, GLASS, DIRT };
+	double takeSeconds = 0, writeSeconds = 0;
+	std::vector<Handout> round;
+	for (int r = 0; r < rounds; r++) {
+		// a chunk and its neighbours, what a background mesher or relight would read
+		const int cx = chunkCoord(rng), cy = chunkCoord(rng), cz = chunkCoord(rng);
+		Chunk& chunk = scratch->GetChunkByIndex(World::GetChunkIndex(cx, cy, cz));
+		round.clear();
+		auto start = BenchClock::now();
+		round.push_back({ chunk.GetSnapshot(), 0 });
+		for (int face = 0; face < Chunk::FACE_COUNT; face++)
+			round.push_back({ chunk.GetNeighbour(face)->GetSnapshot(), 0 });
+		takeSeconds += SecondsSince(start);
+		for (Handout& handout : round)
+			handout.hash = hashBlocks(handout.blocks.GetData());
+		stress.snapshots += (int)round.size();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (Handout& handout : round)
+				mailbox.push_back(std::move(handout));
+		}
+
+		start = BenchClock::now();
+		for (int i = 0; i < 16; i++) {
+			const int gx = cx * Chunk::CHUNK_SIZE + offset(rng), gy = cy * Chunk::CHUNK_SIZE + offset(rng), gz = cz * Chunk::CHUNK_SIZE + offset(rng);
+			scratch->SetCube(gx, gy, gz, palette[rng() % 4]);
+		}
+		writeSeconds += SecondsSince(start);
+		stress.writes += 16;
+	}
+	done = true;
+	for (std::thread& thread : threads)
+		thread.join();
+
+	for (int i = 0; i < World::WORLD_SIZE * World::WORLD_SIZE * World::WORLD_SIZE; i++)
+		stress.clones += scratch->GetChunkByIndex(i).GetCloneCount();
+	stress.clones -= clonesBefore;
+	stress.takeNs = takeSeconds * 1e9 / std::max(1, stress.snapshots);
+	stress.writeUs = writeSeconds * 1e6 / std::max(1, stress.writes);
+	stress.reads = reads;
+	stress.mismatches = mismatches;
+	stress.leakedVersions = ChunkVersion<Chunk::Dims>::live.load() - liveBefore;
+	return stress;
+}
+
+OcclusionCheck CheckOcclusionBuffer() {
+	OcclusionCheck check;
+	// camera at the origin looking down -z, with the game's near plane
+	Matrix view = Matrix::CreateLookAt(Vector3::Zero, Vector3::Forward, Vector3::Up);
+	Matrix proj = Matrix::CreatePerspectiveFieldOfView(XMConvertToRadians(70.0f), 2.0f, 0.01f, 500.0f);
+	auto expect = [&](const OcclusionBuffer& buffer, Vector3 boxMin, Vector3 boxMax, bool visible) {
+		check.checks++;
+		if (buffer.IsVisible(boxMin, boxMax) != visible) check.failures++;
+	};
+
+	auto buffer = std::make_unique<OcclusionBuffer>();
+	buffer->Clear(view * proj);
+	buffer->RasterizeBox(Vector3(-2, -2, -11), Vector3(2, 2, -10));
+	buffer->BuildHiZ();
+	expect(*buffer, Vector3(-1, -1, -31), Vector3(1, 1, -29), false); // behind the wall
+	expect(*buffer, Vector3(-1, -1, -6), Vector3(1, 1, -4), true); // in front of it
+	expect(*buffer, Vector3(10, -1, -31), Vector3(12, 1, -29), true); // behind but beside it
+	expect(*buffer, Vector3(-1, -1, -1), Vector3(1, 1, 1), true); // around the camera
+
+	// a wall on the right reaching behind the camera: clipped at the near plane, it must still hide what's behind it
+	buffer->Clear(view * proj);
+	buffer->RasterizeBox(Vector3(1, -5, -3), Vector3(6, 5, 2));
+	buffer->BuildHiZ();
+	expect(*buffer, Vector3(10, -1, -13), Vector3(12, 1, -11), false);
+	expect(*buffer, Vector3(-12, -1, -13), Vector3(-10, 1, -11), true);
+	return check;
+}
+
+CullingReport CheckVisibilityCulling(World& world) {
+	CullingReport report;
+	const Vector3 spawn = world.GetSpawnPosition();
+	const Vector3 eyes[2] = { spawn + Vector3(0, Player::HEIGHT, 0), spawn - Vector3(0, 3.0f * Chunk::CHUNK_SIZE, 0) };
+	const Quaternion rotations[6] = {
+		Quaternion::Identity,
+		Quaternion::CreateFromAxisAngle(Vector3::Up, XM_PIDIV2),
+		Quaternion::CreateFromAxisAngle(Vector3::Up, XM_PI),
+		Quaternion::CreateFromAxisAngle(Vector3::Up, -XM_PIDIV2),
+		Quaternion::CreateFromAxisAngle(Vector3::Right, XM_PIDIV2),
+		Quaternion::CreateFromAxisAngle(Vector3::Right, -XM_PIDIV2),
+	};
+	Camera camera(60, 1.0f);
+	std::vector<Chunk*> frustum, cave, occlusion;
+	// every chunk of the tighter list must be in the looser one
+	auto contains = [](const std::vector<Chunk*>& loose, const std::vector<Chunk*>& tight) {
+		std::unordered_set<Chunk*> kept(loose.begin(), loose.end());
+		return std::all_of(tight.begin(), tight.end(), [&](Chunk* chunk) { return kept.count(chunk) > 0; });
+	};
+	for (const Vector3& eye : eyes) {
+		Chunk* cameraChunk = world.GetChunk((int)floor(eye.x), (int)floor(eye.y), (int)floor(eye.z));
+		for (const Quaternion& rotation : rotations) {
+			camera.SetPosition(eye);
+			camera.SetRotation(rotation);
+			World::CullStats frustumStats = world.CullFromCamera(camera, false, false, frustum);
+			World::CullStats caveStats = world.CullFromCamera(camera, true, false, cave);
+			World::CullStats occlusionStats = world.CullFromCamera(camera, true, true, occlusion);
+			report.views++;
+			report.total = frustumStats.total;
+			report.frustumDrawn += frustumStats.drawn;
+			report.caveReached += caveStats.reached;
+			report.caveDrawn += caveStats.drawn;
+			report.occlusionDrawn += occlusionStats.drawn;
+
+			bool ok = frustumStats.drawn == frustumStats.frustumVisible;
+			ok = ok && caveStats.drawn == caveStats.reached && contains(frustum, cave) && contains(cave, occlusion);
+			// the BFS starts from the camera chunk, frustum or not
+			ok = ok && (!cameraChunk || std::find(cave.begin(), cave.end(), cameraChunk) != cave.end());
+			report.failures += !ok;
+		}
+	}
+	return report;
+}
+
+void ShowBenchmarksImGui(World& world) {
+	static double collisionQps = 0;
+	static TickTiming entities10k, entities100k;
+	static BroadphaseRates broadphase;
+	static BlockTickTiming flood, sandPillars;
+	static ExplosionTiming tnt;
+	static BlockStateMemory stateMemory;
+	static LightingTiming lightingTiming;
+	static HeightmapTiming heightmaps;
+	static LodReport lodReport;
+	static HorizonTiming horizonTiming;
+	static MeshPatchTiming meshPatch;
+	static DirtyPropagationReport dirtyPropagation;
+	static BrickReport bricks;
+	static std::array<ChunkSizeTiming, 3> chunkSizes;
+	static std::array<VoxelLayoutTiming, 2> voxelLayouts;
+	static SnapshotStress snapshots;
+	static OcclusionCheck occlusion;
+	static CullingReport culling;
+
+	ImGui::Begin("Benchmarks");
+
+	if (ImGui::Button("Collision queries"))
+		collisionQps = BenchmarkCollisionQueries(world, 1000000);
+	ImGui::SameLine();
+	ImGui::Text("%.2f M queries/s", collisionQps / 1e6);
+
+	if (ImGui::Button("Entities 10k"))
+		entities10k = BenchmarkEntities(world, 10000, 120);
+	ImGui::SameLine();
+	ImGui::Text("avg %.2f ms, max %.2f ms / tick", entities10k.avgMs, entities10k.maxMs);
+	if (ImGui::Button("Entities 100k"))
+		entities100k = BenchmarkEntities(world, 100000, 120);
+	ImGui::SameLine();
+	ImGui::Text("avg %.2f ms, max %.2f ms / tick", entities100k.avgMs, entities100k.maxMs);
+
+	if (ImGui::Button("Broadphase 100k"))
+		broadphase = BenchmarkBroadphase(100000, 100000);
+	ImGui::Text("moves %.2f M/s, radius %.2f M/s, aabb %.2f M/s, rays %.2f M/s (%.1f hits)",
+		broadphase.movesPerSecond / 1e6, broadphase.radiusQueriesPerSecond / 1e6, broadphase.aabbQueriesPerSecond / 1e6,
+		broadphase.raysPerSecond / 1e6, broadphase.hitsPerQuery);
+
+	if (ImGui::Button("Flood 64^3"))
+		flood = BenchmarkFlood(world, 64);
+	ImGui::Text("%d steps, %d cells max, %d written, %d dirty chunks, avg %.2f ms, max %.2f ms / step",
+		flood.steps, flood.maxActive, flood.written, flood.dirtyChunks, flood.avgMs, flood.maxMs);
+	if (ImGui::Button("Sand pillars 16x16"))
+		sandPillars = BenchmarkSandPillars(world, 16);
+	ImGui::Text("%d steps, %d cells max, %d written, %d dirty chunks, avg %.2f ms, max %.2f ms / step",
+		sandPillars.steps, sandPillars.maxActive, sandPillars.written, sandPillars.dirtyChunks, sandPillars.avgMs, sandPillars.maxMs);
+
+	if (ImGui::Button("TNT 1000"))
+		tnt = BenchmarkTnt(world, 10);
+	ImGui::Text("%d detonated over %d ticks, %d removed, %d chunks remeshed", tnt.detonated, tnt.ticks, tnt.removed, tnt.remeshed);
+	ImGui::Text("simulation %.2f ms + mesh %.2f ms = %.2f ms to the final mesh", tnt.simulationMs, tnt.meshMs, tnt.simulationMs + tnt.meshMs);
+
+	if (ImGui::Button("Block state memory"))
+		stateMemory = MeasureBlockStateMemory(world);
+	ImGui::Text("%.1f B / chunk (%d chunks with states), %d B for a full chunk, dense would be %d B / chunk",
+		stateMemory.typicalBytes, stateMemory.statefulChunks, (int)stateMemory.heavyBytes, (int)stateMemory.denseBytes);
+
+	if (ImGui::Button("Lighting 1000 edits"))
+		lightingTiming = BenchmarkLighting(world, 1000);
+	ImGui::Text("initial %.1f ms on %d threads, %d updates: avg %.3f ms, max %.3f ms, %.0f cells, %d mismatches",
+		lightingTiming.initialMs, lightingTiming.threads, lightingTiming.updates, lightingTiming.avgMs, lightingTiming.maxMs,
+		lightingTiming.avgCells, lightingTiming.mismatches);
+
+	if (ImGui::Button("Heightmaps"))
+		heightmaps = BenchmarkHeightmaps(world, 1000000, 10000);
+	ImGui::Text("%.1f M queries/s (scan %.1f M/s), %.0f edits/s, %d mismatches",
+		heightmaps.queriesPerSecond / 1e6, heightmaps.scanQueriesPerSecond / 1e6, heightmaps.editsPerSecond, heightmaps.mismatches);
+
+	if (ImGui::Button("LOD"))
+		lodReport = BenchmarkLod(world);
+	ImGui::Text("world: %d triangles, LOD %d / %d / %d, meshed in %.1f ms + %.1f ms", lodReport.worldTriangles[0],
+		lodReport.worldTriangles[1], lodReport.worldTriangles[2], lodReport.worldTriangles[3], lodReport.chunkMeshMs, lodReport.lodMeshMs);
+	ImGui::Text("from spawn: %d chunks, %d / %d / %d nodes, %d triangles instead of %d (%.1f%% less)",
+		lodReport.nodes[0], lodReport.nodes[1], lodReport.nodes[2], lodReport.nodes[3], lodReport.lodTriangles, lodReport.fullTriangles,
+		lodReport.fullTriangles ? 100.0f * (1.0f - lodReport.lodTriangles / (float)lodReport.fullTriangles) : 0.0f);
+
+	if (ImGui::Button("Horizon 2000 steps"))
+		horizonTiming = BenchmarkHorizon(world, 2000);
+	ImGui::Text("%.1f columns sampled, avg %.3f ms, max %.3f ms / step, %d mismatches", horizonTiming.avgSampled,
+		horizonTiming.avgMs, horizonTiming.maxMs, horizonTiming.mismatches);
+	ImGui::Text("%d blocks of view radius in %.1f KB, real chunks would hold %.1f MB of blocks", horizonTiming.radius,
+		horizonTiming.memory / 1024.0, horizonTiming.chunkMemory / (1024.0 * 1024.0));
+
+	if (ImGui::Button("Mesh patch 1k edits"))
+		meshPatch = BenchmarkMeshPatch(world, 1000);
+	ImGui::Text("%.1f chunks / edit, patched avg %.3f ms (max %.3f), rebuilt %.3f ms, %d full rebuilds, %d mismatches",
+		meshPatch.avgChunks, meshPatch.patchMs, meshPatch.maxPatchMs, meshPatch.rebuildMs, meshPatch.rebuilt, meshPatch.mismatches);
+
+	if (ImGui::Button("Dirty propagation"))
+		dirtyPropagation = BenchmarkDirtyPropagation(world);
+	ImGui::Text("%d edits: %d chunks marked (%d marking every border), %d remeshed with light, %d voxels, %.2f ms",
+		dirtyPropagation.edits, dirtyPropagation.markedChunks, dirtyPropagation.borderChunks, dirtyPropagation.remeshedChunks,
+		dirtyPropagation.voxels, dirtyPropagation.meshMs);
+
+	if (ImGui::Button("Bricks"))
+		bricks = BenchmarkBricks(world, 1000);
+	ImGui::Text("draw calls over 6 views: %d per chunk, %d batched (%d empty bricks)", bricks.chunkDrawCalls, bricks.batchDrawCalls, bricks.emptyBricks);
+	ImGui::Text("per edit: %.4f ms brick meshes + %.4f ms batch copies, %d brick writes, %d relayouts",
+		bricks.brickMs, bricks.batchMs, bricks.brickWrites, bricks.relayouts);
+
+	if (ImGui::Button("Chunk sizes"))
+		chunkSizes = BenchmarkChunkSizes(world, 1000000);
+	for (const ChunkSizeTiming& size : chunkSizes) {
+		if (size.side == 0) continue;
+		ImGui::Text("%d^3: %d chunks, generate %.1f ms, %.1f M lookups/s, mesh %.1f ms (%d faces), %.1f us per chunk mesh",
+			size.side, size.chunks, size.generateMs, size.lookupsPerSecond / 1e6, size.meshMs, size.faces, size.chunkMeshUs);
+	}
+
+	if (ImGui::Button("Voxel layouts"))
+		voxelLayouts = BenchmarkVoxelLayout(world, 1000000);
+	for (const VoxelLayoutTiming& layout : voxelLayouts) {
+		ImGui::Text("%s: mesh %.1f ms (%d faces), light %.1f ms (%d cells), %.2f M rays/s (%d hits)", layout.name,
+			layout.meshMs, layout.faces, layout.lightMs, layout.litCells, layout.raysPerSecond / 1e6, layout.rayHits);
+	}
+
+	if (ImGui::Button("Snapshots 4 readers"))
+		snapshots = BenchmarkSnapshots(world, 4, 2000);
+	ImGui::Text("%d snapshots at %.0f ns, %d writes at %.1f us (%d clones), %d reads, %d mismatches, %d leaked versions",
+		snapshots.snapshots, snapshots.takeNs, snapshots.writes, snapshots.writeUs, snapshots.clones, snapshots.reads,
+		snapshots.mismatches, snapshots.leakedVersions);
+
+	if (ImGui::Button("Occlusion buffer"))
+		occlusion = CheckOcclusionBuffer();
+	ImGui::SameLine();
+	ImGui::Text("%d boxes, %d failures", occlusion.checks, occlusion.failures);
+
+	if (ImGui::Button("Visibility culling"))
+		culling = CheckVisibilityCulling(world);
+	ImGui::Text("%d views of %d chunks: frustum %d, cave %d (%d reached), cave + occlusion %d, %d failures", culling.views,
+		culling.total, culling.frustumDrawn, culling.caveDrawn, culling.caveReached, culling.occlusionDrawn, culling.failures);
+
+	ImGui::End();
+}
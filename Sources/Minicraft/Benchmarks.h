@@ -0,0 +1,217 @@
+#pragma once
+
+#include <array>
+
+class World;
+
+struct TickTiming {
+	double avgMs = 0;
+	double maxMs = 0;
+};
+
+// Headless micro benchmarks: nothing here needs a device, they run from the Benchmarks window
+// (or from any test executable linking the Minicraft sources)
+
+// random swept boxes of player size thrown around the world, returns queries per second
+double BenchmarkCollisionQueries(World& world, int queries);
+
+// count entities dropped over the whole world then ticked at 60Hz, timing per tick against the 16.6ms frame
+TickTiming BenchmarkEntities(World& world, int count, int ticks);
+
+struct BroadphaseRates {
+	double movesPerSecond = 0;
+	double radiusQueriesPerSecond = 0;
+	double aabbQueriesPerSecond = 0;
+	double raysPerSecond = 0;
+	double hitsPerQuery = 0;
+};
+// count random entities, then timed teleports (positions and index) and radius / AABB / ray queries through the EntityStore
+BroadphaseRates BenchmarkBroadphase(int count, int queries);
+
+struct BlockTickTiming {
+	int steps = 0; // block tick steps until everything settled
+	int maxActive = 0; // most cells ticked by one step
+	int written = 0;
+	int dirtyChunks = 0; // chunk dirty marks, summed over the steps
+	double avgMs = 0;
+	double maxMs = 0;
+};
+// carves a cavity of size^3 under a lake of sources in a scratch copy of the world, opens the ceiling
+// then runs the block ticks until the water stops moving
+BlockTickTiming BenchmarkFlood(World& world, int size);
+// grid x grid sand pillars 64 blocks tall standing on one stone block each, in a scratch copy of the world:
+// the stones are removed together and the block ticks run until every pillar landed
+BlockTickTiming BenchmarkSandPillars(World& world, int grid);
+
+struct ExplosionTiming {
+	int detonated = 0;
+	int ticks = 0; // until the last chain reaction
+	int removed = 0;
+	int remeshed = 0; // chunks dirty at the end
+	double simulationMs = 0;
+	double meshMs = 0; // CPU meshing of the dirty chunks
+};
+// a side^3 cube of TNT in a scratch copy of the world, the center one is lit and the chain runs to the end,
+// the time to the final mesh is simulationMs + meshMs
+ExplosionTiming BenchmarkTnt(World& world, int side);
+
+struct BlockStateMemory {
+	double typicalBytes = 0; // per chunk, averaged over the world
+	int statefulChunks = 0;
+	size_t heavyBytes = 0; // one chunk full of furnaces, each with a state
+	size_t denseBytes = 0; // what a state byte per cube would cost
+};
+// overhead of the sparse block states, counted on the world and on a synthetic state heavy chunk
+BlockStateMemory MeasureBlockStateMemory(World& world);
+
+struct LightingTiming {
+	double initialMs = 0; // whole world ComputeAll
+	int threads = 0;
+	int updates = 0;
+	double avgMs = 0; // per incremental update
+	double maxMs = 0;
+	double avgCells = 0; // light values changed per update
+	int mismatches = 0; // cells where the incremental result differs from a full relight
+};
+// relights a scratch copy of the world, then digs, builds and lights furnaces at random spots of the surface,
+// each edit relit incrementally, and compares the result with a full relight
+LightingTiming BenchmarkLighting(World& world, int edits);
+
+struct HeightmapTiming {
+	double queriesPerSecond = 0; // GetSolidHeight + GetLightBlockingHeight pairs
+	double scanQueriesPerSecond = 0; // same answers walking the column down
+	double editsPerSecond = 0; // SetCube, heightmap and light updates included
+	int mismatches = 0; // columns differing from a rebuild after the edits
+};
+// random column queries against a top down scan, then random digs and builds on a scratch copy of the world
+// checked against a full rebuild of the heightmaps
+HeightmapTiming BenchmarkHeightmaps(World& world, int queries, int edits);
+
+struct LodReport {
+	double chunkMeshMs = 0; // CPU meshing of every chunk
+	double lodMeshMs = 0; // every LOD node of every level
+	int worldTriangles[4] = {}; // whole world at full resolution, then per LOD level
+	int nodes[4] = {}; // drawn from the camera, chunks in [0]
+	int fullTriangles = 0; // drawn from the camera with chunks only
+	int lodTriangles = 0;
+};
+// meshes a scratch copy of the world at every level, then selects the LOD from the spawn point over the 6 views
+// of a cube map (everything around the camera, frustum culled) and compares the triangles drawn
+LodReport BenchmarkLod(World& world);
+
+struct HorizonTiming {
+	int steps = 0;
+	double avgSampled = 0; // columns sampled per step
+	double avgMs = 0; // Update + BuildMesh per step
+	double maxMs = 0;
+	int mismatches = 0; // samples differing from the generator at the end
+	size_t memory = 0;
+	int radius = 0; // blocks from the camera to the edge of the last level
+	size_t chunkMemory = 0; // block data of real chunks over the same square, full world height
+};
+// a camera flying over the horizon of the world's generator, one block per step along x then z
+HorizonTiming BenchmarkHorizon(World& world, int steps);
+
+struct MeshPatchTiming {
+	int edits = 0;
+	double avgChunks = 0; // chunks with faces to redo per edit
+	double patchMs = 0; // per edit, UpdateMesh of those chunks
+	double maxPatchMs = 0;
+	double rebuildMs = 0; // per edit, full BuildMesh of the same chunks
+	int rebuilt = 0; // chunks that fell back to a full rebuild (too many voxels)
+	int mismatches = 0; // patched meshes whose faces differ from the rebuild
+};
+// random surface digs and builds on a scratch copy of the world with every chunk meshed, the edit-to-mesh time
+// of the in place patches against a full rebuild of the same chunks
+MeshPatchTiming BenchmarkMeshPatch(World& world, int edits);
+
+struct DirtyPropagationReport {
+	int edits = 0;
+	int markedChunks = 0; // chunk marks from the block faces, summed over the edits
+	int borderChunks = 0; // the same when every chunk across the cube's borders is marked, faces changed or not
+	int remeshedChunks = 0; // chunks meshed after the edits, light changes included
+	int voxels = 0; // voxels those meshes re-emitted
+	double meshMs = 0;
+};
+// scripted edits along a chunk border on a scratch copy of the world with every chunk meshed: a tunnel, block
+// swaps that keep the faces and a glass wall in the air, remeshed after each edit
+DirtyPropagationReport BenchmarkDirtyPropagation(World& world);
+
+struct BrickReport {
+	int chunkDrawCalls = 0; // one per visible chunk with opaque faces
+	int batchDrawCalls = 0; // one per run of visible bricks in a batch
+	int emptyBricks = 0;
+	int edits = 0;
+	double brickMs = 0; // per edit, meshing of the chunks it touched
+	double batchMs = 0; // per edit, catching the batches up with them
+	int brickWrites = 0; // brick ranges rewritten in place
+	int relayouts = 0; // batches rebuilt because a brick outgrew its range
+};
+// the opaque draw calls over the 6 views of a cube map from the spawn point, chunk by chunk against batched,
+// then random surface edits on a scratch copy of the world with the cost of keeping the batches up to date
+BrickReport BenchmarkBricks(World& world, int edits);
+
+struct ChunkSizeTiming {
+	int side = 0;
+	int chunks = 0;
+	double generateMs = 0; // the whole world
+	double lookupsPerSecond = 0; // random blocks through the chunk array
+	double meshMs = 0; // visible faces of every chunk, as quads
+	int faces = 0;
+	int meshedChunks = 0; // with some face
+	double chunkMeshUs = 0; // per meshed chunk, the floor of an edit's latency
+};
+// the world's terrain cut in chunks of 8^3, 16^3 and 32^3 with the same kernels instantiated per size
+std::array<ChunkSizeTiming, 3> BenchmarkChunkSizes(World& world, int lookups);
+
+struct VoxelLayoutTiming {
+	const char* name = "";
+	double meshMs = 0; // visible faces of every chunk
+	int faces = 0;
+	double lightMs = 0; // sky light flooded down from the top of the world
+	int litCells = 0;
+	double raysPerSecond = 0; // random rays stepped cube by cube to the first opaque one
+	int rayHits = 0;
+};
+// the world's terrain in 8^3 chunks stored linearly, then in Z-order for both the voxels and the chunk grid:
+// the same mesh, light flood and raycasts on each, the counts must match
+std::array<VoxelLayoutTiming, 2> BenchmarkVoxelLayout(World& world, int rays);
+
+struct SnapshotStress {
+	int readers = 0;
+	int rounds = 0;
+	int snapshots = 0; // handed to the readers, a chunk and its neighbours per round
+	double takeNs = 0; // per snapshot
+	int writes = 0;
+	int clones = 0; // writes that copied the blocks of a chunk a reader still held
+	double writeUs = 0; // per SetCube, clones included
+	int reads = 0; // passes of the readers over a snapshot
+	int mismatches = 0; // passes that saw other blocks than when the snapshot was taken
+	int leakedVersions = 0; // block versions still alive once the readers dropped everything
+};
+// a scratch copy of the world edited on this thread while reader threads hash the snapshots it hands them,
+// meant to run under a thread sanitizer too
+SnapshotStress BenchmarkSnapshots(World& world, int readers, int rounds);
+
+struct OcclusionCheck {
+	int checks = 0;
+	int failures = 0; // boxes reported hidden while visible, or the other way around
+};
+// known boxes tested against known walls in a headless occlusion buffer: behind, in front, beside, across the near
+// plane, and behind a wall that itself crosses the near plane
+OcclusionCheck CheckOcclusionBuffer();
+
+struct CullingReport {
+	int views = 0;
+	int total = 0; // chunks, per view
+	int frustumDrawn = 0; // summed over the views, frustum culling alone
+	int caveReached = 0; // cave culling alone, chunks reached by the BFS
+	int caveDrawn = 0;
+	int occlusionDrawn = 0; // cave then occlusion culling
+	int failures = 0; // views missing the camera chunk, or drawing a chunk the looser culling dropped
+};
+// World::CullFromCamera over the 6 views of a cube map from above the spawn point then from under the ground,
+// with frustum culling only, cave culling only and cave then occlusion culling
+CullingReport CheckVisibilityCulling(World& world);
+
+void ShowBenchmarksImGui(World& world);
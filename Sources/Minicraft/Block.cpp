@@ -2,12 +2,7 @@
 
 #include "Block.h"
 
-#define CREATE_BLOCK_DATA( ... ) BlockData(__VA_ARGS__),
-const BlockData blocksData[] = {
-	BLOCKS(CREATE_BLOCK_DATA)
-};
-
 const BlockData& BlockData::Get(const BlockId id) {
-	if (id < 0 || id > COUNT) return blocksData[EMPTY];
-	return blocksData[id];
+	if (id > COUNT) return BLOCKS_DATA[EMPTY];
+	return BLOCKS_DATA[id];
 }
\ No newline at end of file
@@ -17,6 +17,8 @@ enum BlockFlags : uint64_t {
 	BF_NO_RAYCAST = 1 << 4,
 
 	BF_HALF_BLOCK = 1 << 5,
+	BF_GRAVITY_FALL = 1 << 6, // falls when nothing holds it (sand, gravel)
+	BF_HAS_STATE = 1 << 7, // orientation / on-off bits, see BlockState
 };
 
 #define BLOCKS(F) \
@@ -34,8 +36,8 @@ enum BlockFlags : uint64_t {
 	F( TNT,					8, 9, 10 ) \
 	F( COBBLESTONE,			16 ) \
 	F( BEDROCK,				17 ) \
-	F( SAND,				18 ) \
-	F( GRAVEL,				19 ) \
+	F( SAND,				18, BF_GRAVITY_FALL ) \
+	F( GRAVEL,				19, BF_GRAVITY_FALL ) \
 	F( LOG,					20, 21, 21 ) \
 	F( SPONGE,				48 ) \
 	F( WOOL,				64 ) \
@@ -52,23 +54,45 @@ enum BlockFlags : uint64_t {
 	F( OBSIDIAN,			37 ) \
 \
 /* OBJECTS */ \
-	F( CRAFTING_TABLE,		59, 43, 4 ) /* there is a side variation at index 60 */ \
-	F( FURNACE,				44, 62, 62 ) /* need an orientation & on/off flag */ \
-	F( DISPENSER,			46, 62, 62 ) /* need an orientation flag */ \
+	F( CRAFTING_TABLE,		59, 43, 4, BF_HAS_STATE ) /* the side variation at index 60 comes from the state */ \
+	F( FURNACE,				44, 62, 62, BF_HAS_STATE ) /* orientation & on/off in the state */ \
+	F( DISPENSER,			46, 62, 62, BF_HAS_STATE ) /* orientation in the state */ \
 /* TRANSPARENT STUFF */ \
 	F( GLASS,				49, BF_CUTOUT ) \
 	F( WATER,				205, BF_NO_PHYSICS | BF_GRAVITY_WATER | BF_NO_RAYCAST, SP_TRANSPARENT ) \
+/* flowing water, level 1 to 7 (WATER is the full source) */ \
+	F( WATER_FLOW_1,		205, BF_NO_PHYSICS | BF_GRAVITY_WATER | BF_NO_RAYCAST, SP_TRANSPARENT ) \
+	F( WATER_FLOW_2,		205, BF_NO_PHYSICS | BF_GRAVITY_WATER | BF_NO_RAYCAST, SP_TRANSPARENT ) \
+	F( WATER_FLOW_3,		205, BF_NO_PHYSICS | BF_GRAVITY_WATER | BF_NO_RAYCAST, SP_TRANSPARENT ) \
+	F( WATER_FLOW_4,		205, BF_NO_PHYSICS | BF_GRAVITY_WATER | BF_NO_RAYCAST, SP_TRANSPARENT ) \
+	F( WATER_FLOW_5,		205, BF_NO_PHYSICS | BF_GRAVITY_WATER | BF_NO_RAYCAST, SP_TRANSPARENT ) \
+	F( WATER_FLOW_6,		205, BF_NO_PHYSICS | BF_GRAVITY_WATER | BF_NO_RAYCAST, SP_TRANSPARENT ) \
+	F( WATER_FLOW_7,		205, BF_NO_PHYSICS | BF_GRAVITY_WATER | BF_NO_RAYCAST, SP_TRANSPARENT ) \
 /* 38, 39 & 40 contains greyscale grass for biome variation */ \
 /* as an exercice you can try to implement that by adding back some vertex color informations to the pipeline */ \
 /* 52, 53 contains greyscale leaves */ \
 	F( HIGHLIGHT, 180) \
 	F( COUNT, -1)
 
-#define EXTRACT_BLOCK_ID( v ) v,
+// variadic so the extra columns of a row are dropped on every preprocessor, not only MSVC's
+#define EXTRACT_BLOCK_ID( v, ... ) v,
 enum BlockId: uint8_t {
 	BLOCKS(EXTRACT_BLOCK_ID)
 };
 
+// water levels: 0 for anything else, 8 for the WATER source
+constexpr int WATER_SOURCE_LEVEL = 8;
+constexpr int GetWaterLevel(BlockId id) {
+	if (id == WATER) return WATER_SOURCE_LEVEL;
+	if (id >= WATER_FLOW_1 && id <= WATER_FLOW_7) return id - WATER_FLOW_1 + 1;
+	return 0;
+}
+constexpr BlockId GetWaterBlock(int level) {
+	if (level <= 0) return EMPTY;
+	if (level >= WATER_SOURCE_LEVEL) return WATER;
+	return (BlockId)(WATER_FLOW_1 + level - 1);
+}
+
 class BlockData {
 public:
 	BlockId id;
@@ -79,22 +103,160 @@ public:
 
 	uint64_t flags;
 	ShaderPass pass;
+	float resistance; // how much of an explosion ray the block absorbs
 public:
-	BlockData(BlockId id, int texId, uint64_t flags = BF_NONE, ShaderPass pass = SP_OPAQUE) :
+	constexpr BlockData(BlockId id, int texId, uint64_t flags = BF_NONE, ShaderPass pass = SP_OPAQUE) :
 		id(id),
 		texIdSide(texId),
 		texIdTop(texId),
 		texIdBottom(texId),
 		flags(flags),
-		pass(pass) {}
+		pass(pass),
+		resistance(GetDefaultResistance(id)) {}
 
-	BlockData(BlockId id, int texIdSide, int texIdTop, int texIdBottom, uint64_t flags = BF_NONE, ShaderPass pass = SP_OPAQUE) :
+	constexpr BlockData(BlockId id, int texIdSide, int texIdTop, int texIdBottom, uint64_t flags = BF_NONE, ShaderPass pass = SP_OPAQUE) :
 		id(id),
 		texIdSide(texIdSide),
 		texIdTop(texIdTop),
 		texIdBottom(texIdBottom),
 		flags(flags),
-		pass(pass) {}
+		pass(pass),
+		resistance(GetDefaultResistance(id)) {}
+
+	// fully hides what is behind it (used by the visibility flood fill)
+	constexpr bool IsOpaque() const { return id != EMPTY && pass == SP_OPAQUE && !(flags & (BF_CUTOUT | BF_HALF_BLOCK)); }
 
 	static const BlockData& Get(const BlockId id);
+private:
+	// blast resistances, same scale as Minecraft
+	static constexpr float GetDefaultResistance(BlockId id) {
+		switch (id) {
+		case EMPTY: case TNT: case HIGHLIGHT: return 0.0f;
+		case GLASS: return 0.3f;
+		case DIRT: case GRASS: case SAND: return 0.5f;
+		case GRAVEL: case SPONGE: return 0.6f;
+		case WOOL: return 0.8f;
+		case BOOKSHELF: return 1.5f;
+		case LOG: return 2.0f;
+		case CRAFTING_TABLE: return 2.5f;
+		case WOOD: case COAL: case IRON_ORE: case GOLD_ORE: case DIAMOND_ORE: case REDSTONE_ORE: return 3.0f;
+		case FURNACE: case DISPENSER: return 3.5f;
+		case OBSIDIAN: return 1200.0f;
+		case BEDROCK: return 3600000.0f;
+		default:
+			if (GetWaterLevel(id)) return 100.0f;
+			return 6.0f; // stone, bricks, metal blocks
+		}
+	}
+};
+
+#define CREATE_BLOCK_DATA( ... ) BlockData(__VA_ARGS__),
+inline constexpr BlockData BLOCKS_DATA[] = {
+	BLOCKS(CREATE_BLOCK_DATA)
+};
+static_assert(sizeof(BLOCKS_DATA) / sizeof(BlockData) == COUNT + 1, "one BlockData per BlockId");
+
+// Extra bits of the BF_HAS_STATE blocks. Chunks only store them for the few blocks that have one,
+// the dense BlockId array doesn't grow
+using BlockState = uint8_t;
+enum BlockStateBits : uint8_t {
+	BS_FACING_MASK = 3, // side the front looks at, in Chunk::PushCube order: +z, +x, -z, -x
+	BS_LIT = 1 << 2, // burning furnace
+};
+constexpr int GetFacing(BlockState state) { return state & BS_FACING_MASK; }
+
+// side textures of the BF_HAS_STATE blocks, picked by the mesher from the state
+struct StateTextures {
+	int front;
+	int frontLit;
+	int side;
+	bool frontAndBack; // the face opposite to the front uses the front texture too
 };
+constexpr StateTextures GetStateTextures(BlockId id) {
+	switch (id) {
+	case FURNACE: return { 44, 61, 45, false };
+	case DISPENSER: return { 46, 46, 45, false };
+	case CRAFTING_TABLE: return { 59, 59, 60, true };
+	default: return { 0, 0, 0, false };
+	}
+}
+
+// The mesher's view of BLOCKS_DATA, built at compile time: one entry for every value a BlockId can take
+// (the ones past COUNT stay zero), so lookups need no range check and touch a few bytes instead of a BlockData.
+namespace BlockTables {
+	constexpr int SIZE = 256;
+	static_assert(COUNT < SIZE, "BlockId is a uint8_t");
+	static_assert(BF_HAS_STATE < 256, "the packed flags are a uint8_t");
+
+	enum TexFace { TF_SIDE, TF_TOP, TF_BOTTOM, TF_COUNT };
+	enum StateFace { SF_FRONT, SF_FRONT_LIT, SF_SIDE, SF_COUNT };
+	// atlas rectangle of a face texture, v0 is the top of the tile
+	struct FaceUV {
+		float u0, v0, u1, v1;
+	};
+
+	struct Tables {
+		uint8_t flags[SIZE];
+		uint8_t pass[SIZE];
+		bool opaque[SIZE];
+		FaceUV uvs[SIZE][TF_COUNT];
+		FaceUV stateUvs[SIZE][SF_COUNT]; // side faces of the BF_HAS_STATE blocks
+		uint64_t hides[SIZE][SIZE / 64]; // bit b of hides[a]: a neighbour b hides the faces of a
+	};
+
+	constexpr FaceUV GetTileUV(int texId) {
+		float u = (texId % 16) / 16.0f;
+		float v = (texId / 16) / 16.0f;
+		return { u, v, u + 1.0f / 16.0f, v + 1.0f / 16.0f };
+	}
+
+	constexpr Tables Build() {
+		Tables tables = {};
+		for (int a = 0; a <= COUNT; a++) {
+			const BlockData& data = BLOCKS_DATA[a];
+			tables.flags[a] = (uint8_t)data.flags;
+			tables.pass[a] = (uint8_t)data.pass;
+			tables.opaque[a] = data.IsOpaque();
+			tables.uvs[a][TF_SIDE] = GetTileUV(data.texIdSide);
+			tables.uvs[a][TF_TOP] = GetTileUV(data.texIdTop);
+			tables.uvs[a][TF_BOTTOM] = GetTileUV(data.texIdBottom);
+			if (data.flags & BF_HAS_STATE) {
+				StateTextures textures = GetStateTextures((BlockId)a);
+				tables.stateUvs[a][SF_FRONT] = GetTileUV(textures.front);
+				tables.stateUvs[a][SF_FRONT_LIT] = GetTileUV(textures.frontLit);
+				tables.stateUvs[a][SF_SIDE] = GetTileUV(textures.side);
+			}
+		}
+		// a face is drawn against nothing, and an opaque pass face against the transparent pass (water)
+		for (int a = 0; a <= COUNT; a++) {
+			for (int b = 0; b <= COUNT; b++) {
+				bool visible = b == EMPTY || (BLOCKS_DATA[a].pass == SP_OPAQUE && BLOCKS_DATA[b].pass == SP_TRANSPARENT);
+				if (!visible) tables.hides[a][b / 64] |= 1ull << (b % 64);
+			}
+		}
+		return tables;
+	}
+
+	inline constexpr Tables TABLES = Build();
+
+	constexpr uint8_t GetFlags(BlockId id) { return TABLES.flags[id]; }
+	constexpr bool IsOpaque(BlockId id) { return TABLES.opaque[id]; }
+	constexpr const FaceUV& GetUV(BlockId id, TexFace face) { return TABLES.uvs[id][face]; }
+	constexpr const FaceUV& GetStateUV(BlockId id, StateFace face) { return TABLES.stateUvs[id][face]; }
+	constexpr ShaderPass GetPass(BlockId id) { return (ShaderPass)TABLES.pass[id]; }
+	constexpr bool Hides(BlockId id, BlockId neighbour) { return (TABLES.hides[id][neighbour / 64] >> (neighbour % 64)) & 1; }
+}
+
+struct BlockEdit {
+	int gx, gy, gz;
+	BlockId id;
+	BlockState state = 0; // of a block with BF_HAS_STATE
+};
+
+// world cell as a single key, 10 bits per axis
+inline uint32_t PackCell(int gx, int gy, int gz) { return (uint32_t)gx | (uint32_t)gy << 10 | (uint32_t)gz << 20; }
+inline void UnpackCell(uint32_t key, int& gx, int& gy, int& gz) {
+	gx = key & 1023;
+	gy = (key >> 10) & 1023;
+	gz = key >> 20;
+}
@@ -0,0 +1,196 @@
+#include "pch.h"
+
+#include "BlockTicks.h"
+#include "World.h"
+#include <chrono>
+
+constexpr Chunk::Face HORIZONTAL_FACES[4] = { Chunk::FACE_POS_X, Chunk::FACE_NEG_X, Chunk::FACE_POS_Z, Chunk::FACE_NEG_Z };
+
+void BlockTicks::Notify(World& world, int gx, int gy, int gz) {
+	auto notifyCell = [&](int x, int y, int z) {
+		const BlockId* cube = world.ReadCube(x, y, z);
+		if (!cube) return;
+		int delay = GetDelay(*cube);
+		if (delay >= 0) Schedule(x, y, z, delay);
+	};
+	notifyCell(gx, gy, gz);
+	notifyCell(gx + 1, gy, gz);
+	notifyCell(gx - 1, gy, gz);
+	notifyCell(gx, gy + 1, gz);
+	notifyCell(gx, gy - 1, gz);
+	notifyCell(gx, gy, gz + 1);
+	notifyCell(gx, gy, gz - 1);
+}
+
+void BlockTicks::Schedule(int gx, int gy, int gz, int delay) {
+	delay = std::clamp(delay, 1, RING_SIZE - 1);
+	uint32_t key = PackCell(gx, gy, gz);
+	uint64_t due = tick + delay;
+	auto [it, inserted] = scheduled.emplace(key, due);
+	// already pending: a later tick would see this change too, an earlier one moves the cell.
+	// The key stays in the later slot where Tick skips it, the due tick no longer matches
+	if (!inserted) {
+		if (due >= it->second) return;
+		it->second = due;
+	}
+	ring[due % RING_SIZE].push_back(key);
+}
+
+void BlockTicks::Tick(World& world) {
+	if (!enabled) return; // paused, the pending ticks wait
+	tick++;
+	auto start = std::chrono::steady_clock::now();
+
+	processing.swap(ring[tick % RING_SIZE]);
+	stats.processed = 0;
+	for (uint32_t key : processing) {
+		auto it = scheduled.find(key);
+		if (it == scheduled.end() || it->second != tick) continue;
+		scheduled.erase(it);
+
+		int gx, gy, gz;
+		UnpackCell(key, gx, gy, gz);
+		const BlockId* cube = world.ReadCube(gx, gy, gz);
+		if (!cube) continue;
+		uint64_t flags = BlockData::Get(*cube).flags;
+		if (flags & BF_GRAVITY_WATER)
+			TickWater(world, gx, gy, gz, *cube);
+		else if (flags & BF_GRAVITY_FALL)
+			TickFalling(world, gx, gy, gz);
+		stats.processed++;
+	}
+	processing.clear();
+
+	// every cell read the same world state, now write them all at once: one dirty mark per chunk
+	batch.clear();
+	for (auto& write : writes) {
+		int gx, gy, gz;
+		UnpackCell(write.first, gx, gy, gz);
+		batch.push_back({ gx, gy, gz, write.second });
+	}
+	writes.clear();
+	stats.written = (int)batch.size();
+	stats.dirtyChunks = batch.empty() ? 0 : world.ApplyEdits(batch);
+
+	stats.pending = (int)scheduled.size();
+	stats.stepMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void BlockTicks::Clear() {
+	for (auto& slot : ring)
+		slot.clear();
+	scheduled.clear();
+	writes.clear();
+	stats = Stats();
+}
+
+int BlockTicks::GetDelay(BlockId id) const {
+	uint64_t flags = BlockData::Get(id).flags;
+	if (flags & BF_GRAVITY_WATER) return waterDelay;
+	if (flags & BF_GRAVITY_FALL) return fallDelay;
+	return -1;
+}
+
+// Levels go from 8 (WATER, the source) down to 1. A flowing cell is fed by the water above it (level 7, falling)
+// or by its highest horizontal neighbour minus one, and dries up when nothing feeds it anymore.
+// Water falls first, and only spreads sideways when it rests on something solid or on a source.
+void BlockTicks::TickWater(World& world, int gx, int gy, int gz, BlockId id) {
+	// the neighbours are read through the chunk links
+	const ChunkCursor cell = world.GetCursor(gx, gy, gz);
+	auto getCube = [&](int face) {
+		ChunkCursor next = cell.Neighbour(face);
+		return next.IsValid() ? *next.GetCube() : BEDROCK; // the world border holds water like a wall
+	};
+	auto isSolid = [](BlockId cube) {
+		return !(BlockData::Get(cube).flags & BF_NO_PHYSICS);
+	};
+	auto canFlowInto = [](BlockId cube, int level) {
+		int current = GetWaterLevel(cube);
+		return cube == EMPTY || (current > 0 && current < level && cube != WATER);
+	};
+
+	int level = GetWaterLevel(id);
+	BlockId below = getCube(Chunk::FACE_NEG_Y);
+	if (id != WATER) {
+		int fed = GetWaterLevel(getCube(Chunk::FACE_POS_Y)) > 0 ? WATER_SOURCE_LEVEL - 1 : 0;
+		int sources = 0;
+		for (Chunk::Face face : HORIZONTAL_FACES) {
+			BlockId neighbour = getCube(face);
+			fed = std::max(fed, GetWaterLevel(neighbour) - 1);
+			sources += neighbour == WATER;
+		}
+		// between two sources, over something that holds it, the water renews itself
+		if (infiniteSources && sources >= 2 && (isSolid(below) || below == WATER))
+			fed = WATER_SOURCE_LEVEL;
+		if (fed != level) {
+			Write(gx, gy, gz, GetWaterBlock(fed));
+			if (fed <= 0) return;
+			level = fed;
+		}
+	}
+
+	if (canFlowInto(below, WATER_SOURCE_LEVEL - 1)) {
+		Write(gx, gy - 1, gz, GetWaterBlock(WATER_SOURCE_LEVEL - 1));
+		return;
+	}
+	if (level <= 1 || !(isSolid(below) || below == WATER)) return;
+	for (Chunk::Face face : HORIZONTAL_FACES) {
+		if (canFlowInto(getCube(face), level - 1))
+			Write(gx + Chunk::FACE_DIRS[face][0], gy, gz + Chunk::FACE_DIRS[face][2], GetWaterBlock(level - 1));
+	}
+}
+
+// A block without support drops in one step with the whole falling column above it, down to the first solid
+// block: N blocks moved by one batch instead of N steps of one block. Water in the way is crushed.
+void BlockTicks::TickFalling(World& world, int gx, int gy, int gz) {
+	auto getCube = [&](int y) {
+		const BlockId* cube = world.ReadCube(gx, y, gz);
+		return cube ? *cube : BEDROCK;
+	};
+	auto isFalling = [](BlockId cube) { return (BlockData::Get(cube).flags & BF_GRAVITY_FALL) != 0; };
+	auto isPassable = [](BlockId cube) { return (BlockData::Get(cube).flags & BF_NO_PHYSICS) != 0; };
+
+	// only the lowest falling block of the column has a passable cell below, it carries the ones above
+	if (!isPassable(getCube(gy - 1))) return;
+
+	int landing = gy - 1;
+	while (isPassable(getCube(landing - 1)))
+		landing--;
+	int top = gy;
+	while (isFalling(getCube(top + 1)))
+		top++;
+
+	// the column [gy, top] moves down to landing, the cells it leaves become empty
+	int height = top - gy + 1;
+	for (int y = landing; y <= top; y++) {
+		if (y < landing + height)
+			Write(gx, y, gz, getCube(gy + y - landing));
+		else if (y >= gy)
+			Write(gx, y, gz, EMPTY);
+	}
+}
+
+// several cells can write the same one during a step: solid blocks first, then the most water
+void BlockTicks::Write(int gx, int gy, int gz, BlockId id) {
+	auto priority = [](BlockId cube) {
+		if (cube == EMPTY) return 0;
+		int level = GetWaterLevel(cube);
+		return level > 0 ? level : WATER_SOURCE_LEVEL + 1;
+	};
+	auto result = writes.emplace(PackCell(gx, gy, gz), id);
+	if (!result.second && priority(id) > priority(result.first->second))
+		result.first->second = id;
+}
+
+void BlockTicks::ShowImGui() {
+	ImGui::Begin("Block ticks");
+
+	ImGui::Checkbox("Enabled", &enabled);
+	ImGui::SliderInt("Water delay", &waterDelay, 1, RING_SIZE - 1);
+	ImGui::Checkbox("Infinite sources", &infiniteSources);
+	ImGui::SliderInt("Fall delay", &fallDelay, 1, RING_SIZE - 1);
+	ImGui::Text("%d pending, %d ticked, %d written", stats.pending, stats.processed, stats.written);
+	ImGui::Text("Step %.3f ms", stats.stepMs);
+
+	ImGui::End();
+}
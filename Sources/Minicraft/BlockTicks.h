@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Block.h"
+#include <array>
+#include <unordered_map>
+#include <vector>
+
+class World;
+
+// Scheduled block ticks: only the cells that may change are queued (the active cells), every edit notifies
+// the edited cell and its 6 neighbours, so the cost follows the activity and never the world size.
+// A step reads the world as it was at the start of the step and hands all its writes to one World::ApplyEdits,
+// so a chunk touched by many cells is still marked dirty (and remeshed) once per step.
+class BlockTicks {
+public:
+	constexpr static int RING_SIZE = 64; // longest delay, in ticks
+	struct Stats {
+		int processed = 0; // cells ticked by the last step
+		int written = 0; // cells changed by the last step
+		int pending = 0;
+		int dirtyChunks = 0; // chunks marked dirty by the last step
+		double stepMs = 0;
+	};
+private:
+	std::array<std::vector<uint32_t>, RING_SIZE> ring; // cells due at tick % RING_SIZE
+	std::unordered_map<uint32_t, uint64_t> scheduled; // cell -> due tick, at most one pending tick per cell
+	std::unordered_map<uint32_t, BlockId> writes; // the step's result, one block per cell
+	std::vector<uint32_t> processing;
+	std::vector<BlockEdit> batch;
+	uint64_t tick = 0;
+	int waterDelay = 5; // ticks between two water steps, 12 per second at 60Hz
+	int fallDelay = 2;
+	bool infiniteSources = true;
+	bool enabled = true;
+	Stats stats;
+public:
+	// something changed at the cell: schedules it and its neighbours when their block ticks
+	void Notify(World& world, int gx, int gy, int gz);
+	void Schedule(int gx, int gy, int gz, int delay);
+	// runs the cells due this tick then applies their writes in one batch
+	void Tick(World& world);
+	void Clear();
+
+	int GetPendingCount() const { return (int)scheduled.size(); }
+	const Stats& GetStats() const { return stats; }
+	void ShowImGui();
+private:
+	int GetDelay(BlockId id) const; // -1: the block never ticks
+	void TickWater(World& world, int gx, int gy, int gz, BlockId id);
+	void TickFalling(World& world, int gx, int gy, int gz);
+	void Write(int gx, int gy, int gz, BlockId id);
+};
@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "Chunk.h"
 #include "World.h"
+#include "ChunkKernels.h"
 
 void Chunk::SetPosition(World* world, int cx, int cy, int cz) {
 	mModel = Matrix::CreateTranslation(Vector3(cx, cy, cz) * Chunk::CHUNK_SIZE);
@@ -14,10 +15,24 @@ void Chunk::SetPosition(World* world, int cx, int cy, int cz) {
 }
 
 void Chunk::Generate(DeviceResources* deviceRes) {
+	BuildMesh();
+	dirty = false;
+	for (int pass = SP_OPAQUE; pass < SP_COUNT; pass++)
+		Upload(deviceRes, (ShaderPass)pass);
+}
+
+void Chunk::BuildMesh() {
 	for (int pass = SP_OPAQUE; pass < SP_COUNT; pass++) {
 		vBuffer[pass].Clear();
 		iBuffer[pass].Clear();
+		freeSlots[pass].clear();
 	}
+	std::fill(faceSlots.begin(), faceSlots.end(), 0);
+	ResetPatches();
+	meshVersion++;
+	createUploads = (1 << SP_COUNT) - 1;
+	// nothing to see in an empty brick, nor in a full one walled in by full ones
+	if (IsEmpty() || IsEnclosed()) return;
 	for (int z = 0; z < CHUNK_SIZE; z++) {
 		for (int y = 0; y < CHUNK_SIZE; y++) {
 			for (int x = 0; x < CHUNK_SIZE; x++) {
@@ -25,86 +40,354 @@ void Chunk::Generate(DeviceResources* deviceRes) {
 			}
 		}
 	}
+}
+
+void Chunk::MarkVoxelDirty(int lx, int ly, int lz, bool blocksChanged) {
+	if (blocksChanged) visibilityDirty = true;
+	if (dirty) return; // the full rebuild covers it
+	int index = GetLocalIndex(lx, ly, lz);
+	if (!blocksChanged && blocks.Read()[index] == EMPTY) return; // no face to redo
+	// the first edit rebuilds the whole mesh once, with the face records
+	if (faceSlots.empty()) {
+		AllocateFaceRecords();
+		return;
+	}
+	if (patchMask[index]) return;
+	patchMask[index] = true;
+
+	const int local[3] = { lx, ly, lz };
+	int volume = 1;
+	for (int axis = 0; axis < 3; axis++) {
+		regionMin[axis] = std::min(regionMin[axis], local[axis]);
+		regionMax[axis] = std::max(regionMax[axis], local[axis]);
+		volume *= regionMax[axis] - regionMin[axis] + 1;
+	}
+	if (!regionPatch) {
+		patchVoxels.push_back((uint16_t)index);
+		if ((int)patchVoxels.size() <= PATCH_LIMIT) return;
+		regionPatch = true;
+		patchVoxels.clear();
+	}
+	if (volume * 2 > CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE) dirty = true;
+}
+
+int Chunk::GetPendingVoxels() const {
+	if (dirty) return CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+	if (!regionPatch) return (int)patchVoxels.size();
+	return (regionMax[0] - regionMin[0] + 1) * (regionMax[1] - regionMin[1] + 1) * (regionMax[2] - regionMin[2] + 1);
+}
+
+bool Chunk::PatchMesh() {
+	if (regionPatch) {
+		for (int z = regionMin[2]; z <= regionMax[2]; z++)
+			for (int y = regionMin[1]; y <= regionMax[1]; y++)
+				for (int x = regionMin[0]; x <= regionMax[0]; x++)
+					RepushVoxel(GetLocalIndex(x, y, z));
+	} else {
+		for (uint16_t voxel : patchVoxels)
+			RepushVoxel(voxel);
+	}
+	ResetPatches();
+	meshVersion++;
+	patchUploads = (1 << SP_COUNT) - 1;
 
+	// degenerate faces still cost vertex work: compact once too many slots are free
 	for (int pass = SP_OPAQUE; pass < SP_COUNT; pass++) {
+		uint32_t slots = vBuffer[pass].Size() / 4;
+		if (slots > 64 && freeSlots[pass].size() * 100 > slots * COMPACT_PERCENT) {
+			BuildMesh();
+			return false;
+		}
+	}
+	return true;
+}
+
+void Chunk::RepushVoxel(int voxel) {
+	RemoveFaces(voxel);
+	PushCube(Dims::IndexX(voxel), Dims::IndexY(voxel), Dims::IndexZ(voxel));
+}
+
+void Chunk::ResetPatches() {
+	patchVoxels.clear();
+	patchMask.reset();
+	regionPatch = false;
+	std::fill(std::begin(regionMin), std::end(regionMin), CHUNK_SIZE);
+	std::fill(std::begin(regionMax), std::end(regionMax), -1);
+}
+
+void Chunk::UpdateMesh() {
+	if (dirty) {
+		BuildMesh();
+		dirty = false;
+	} else if (regionPatch || !patchVoxels.empty()) {
+		PatchMesh();
+	}
+	if (visibilityDirty) UpdateVisibility();
+}
+
+bool Chunk::IsEnclosed() {
+	if (!IsFull()) return false;
+	for (int face = 0; face < FACE_COUNT; face++) {
+		// the faces on the border of the world are drawn
+		if (!neighbours[face] || (lodFaces & (1 << face)) || !neighbours[face]->IsFull()) return false;
+	}
+	return true;
+}
+
+void Chunk::Upload(DeviceResources* deviceRes, ShaderPass pass) {
+	const uint8_t bit = 1 << pass;
+	if (createUploads & bit) {
 		vBuffer[pass].Create(deviceRes);
 		iBuffer[pass].Create(deviceRes);
+	} else if (patchUploads & bit) {
+		// patched in place: the device buffers are rewritten without reallocation when they still fit
+		vBuffer[pass].Update(deviceRes);
+		iBuffer[pass].Update(deviceRes);
 	}
-	dirty = false;
+	createUploads &= ~bit;
+	patchUploads &= ~bit;
+}
+
+uint64_t Chunk::HashFaces() {
+	uint64_t hash = 0;
+	for (int pass = SP_OPAQUE; pass < SP_COUNT; pass++) {
+		for (uint32_t first = 0; first < iBuffer[pass].Size(); first += 6) {
+			if (iBuffer[pass].At(first) == iBuffer[pass].At(first + 1)) continue; // removed face
+			// FNV-1a of the face's vertices, summed so the slot order doesn't matter
+			uint64_t face = 14695981039346656037ull ^ pass;
+			const uint8_t* bytes = (const uint8_t*)&vBuffer[pass].At(iBuffer[pass].At(first));
+			for (size_t i = 0; i < 4 * sizeof(VertexLayout_PositionNormalUVLight); i++)
+				face = (face ^ bytes[i]) * 1099511628211ull;
+			hash += face;
+		}
+	}
+	return hash;
+}
+
+// Flood fill every pocket of non-opaque voxels and record which chunk faces each pocket touches:
+// two faces are connected if one pocket touches both of them
+void Chunk::UpdateVisibility() {
+	constexpr int VOLUME = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+	std::array<bool, VOLUME> visited = {};
+	std::array<uint16_t, VOLUME> stack;
+	const Data& data = blocks.Read();
+
+	empty = std::all_of(data.begin(), data.end(), [](BlockId id) { return id == EMPTY; });
+	hasCollision = std::any_of(data.begin(), data.end(), [](BlockId id) { return !(BlockTables::GetFlags(id) & BF_NO_PHYSICS); });
+
+	// a voxel that isn't opaque breaks its layer on each axis
+	std::fill(std::begin(fullLayers), std::end(fullLayers), (1u << CHUNK_SIZE) - 1);
+	for (int index = 0; index < VOLUME; index++) {
+		if (BlockTables::IsOpaque(data[index])) continue;
+		fullLayers[0] &= ~(1u << Dims::IndexX(index));
+		fullLayers[1] &= ~(1u << Dims::IndexY(index));
+		fullLayers[2] &= ~(1u << Dims::IndexZ(index));
+	}
+
+	connectivity = 0;
+	for (int start = 0; start < VOLUME; start++) {
+		if (visited[start] || BlockTables::IsOpaque(data[start])) continue;
+
+		uint8_t faces = 0;
+		int top = 0;
+		stack[top++] = start;
+		visited[start] = true;
+		while (top > 0) {
+			int index = stack[--top];
+			int lx = Dims::IndexX(index);
+			int ly = Dims::IndexY(index);
+			int lz = Dims::IndexZ(index);
+			for (int face = 0; face < FACE_COUNT; face++) {
+				int nx = lx + FACE_DIRS[face][0];
+				int ny = ly + FACE_DIRS[face][1];
+				int nz = lz + FACE_DIRS[face][2];
+				if (!Dims::IsInside(nx) || !Dims::IsInside(ny) || !Dims::IsInside(nz)) {
+					faces |= 1 << face;
+					continue;
+				}
+				int neighbour = GetLocalIndex(nx, ny, nz);
+				if (visited[neighbour] || BlockTables::IsOpaque(data[neighbour])) continue;
+				visited[neighbour] = true;
+				stack[top++] = neighbour;
+			}
+		}
+
+		for (int a = 0; a < FACE_COUNT; a++) {
+			if (!(faces & (1 << a))) continue;
+			for (int b = 0; b < FACE_COUNT; b++)
+				if (faces & (1 << b)) connectivity |= 1ull << (a * FACE_COUNT + b);
+		}
+	}
+	visibilityDirty = false;
 }
 
 void Chunk::Draw(DeviceResources* deviceRes, ShaderPass pass) {
-	if (dirty) Generate(deviceRes);
+	if (NeedsMeshUpdate()) UpdateMesh();
+	Upload(deviceRes, pass);
 	if (iBuffer[pass].Size() == 0) return;
 	vBuffer[pass].Apply(deviceRes);
 	iBuffer[pass].Apply(deviceRes);
 	deviceRes->GetD3DDeviceContext()->DrawIndexed(iBuffer[pass].Size(), 0, 0);
 }
 
-bool Chunk::ShouldRenderFace(int lx, int ly, int lz, int dx, int dy, int dz) {
-	auto blockIdNeighbour = world->GetCube(
-		cx * CHUNK_SIZE + lx + dx, 
-		cy * CHUNK_SIZE + ly + dy, 
-		cz * CHUNK_SIZE + lz + dz);
-	if (!blockIdNeighbour || *blockIdNeighbour == EMPTY) return true;
+int Chunk::GetOccluders(Vector3 boxMin[3], Vector3 boxMax[3]) {
+	if (visibilityDirty) UpdateVisibility();
+	const Vector3 origin = Vector3(cx, cy, cz) * CHUNK_SIZE;
+	if (IsFull()) {
+		boxMin[0] = origin;
+		boxMax[0] = origin + Vector3(CHUNK_SIZE, CHUNK_SIZE, CHUNK_SIZE);
+		return 1;
+	}
+	int count = 0;
+	for (int axis = 0; axis < 3; axis++) {
+		int bestStart = 0, bestLength = 0;
+		for (int start = 0; start < CHUNK_SIZE;) {
+			int length = 0;
+			while (start + length < CHUNK_SIZE && (fullLayers[axis] & (1u << (start + length)))) length++;
+			if (length > bestLength) {
+				bestStart = start;
+				bestLength = length;
+			}
+			start += length + 1;
+		}
+		if (bestLength == 0) continue;
+		float low[3] = { 0, 0, 0 }, high[3] = { CHUNK_SIZE, CHUNK_SIZE, CHUNK_SIZE };
+		low[axis] = (float)bestStart;
+		high[axis] = (float)(bestStart + bestLength);
+		boxMin[count] = origin + Vector3(low[0], low[1], low[2]);
+		boxMax[count] = origin + Vector3(high[0], high[1], high[2]);
+		count++;
+	}
+	return count;
+}
 
-	auto blockId = world->GetCube(
-		cx * CHUNK_SIZE + lx,
-		cy * CHUNK_SIZE + ly,
-		cz * CHUNK_SIZE + lz);
-	auto& blockData = BlockData::Get(*blockId);
-	auto& blockDataNeighbour = BlockData::Get(*blockIdNeighbour);
+BlockId* Chunk::GetChunkCube(int lx, int ly, int lz) {
+	if (!Dims::IsInside(lx) || !Dims::IsInside(ly) || !Dims::IsInside(lz)) return nullptr;
+	return &blocks.Write()[GetLocalIndex(lx, ly, lz)];
+}
 
-	if (blockData.pass == SP_OPAQUE && blockDataNeighbour.pass == SP_TRANSPARENT) return true;
+const BlockId* Chunk::GetChunkCube(int lx, int ly, int lz) const {
+	if (!Dims::IsInside(lx) || !Dims::IsInside(ly) || !Dims::IsInside(lz)) return nullptr;
+	return &blocks.Read()[GetLocalIndex(lx, ly, lz)];
+}
 
-	return false;
+BlockState Chunk::GetState(int lx, int ly, int lz) const {
+	if (states.empty()) return 0;
+	uint16_t index = (uint16_t)GetLocalIndex(lx, ly, lz);
+	auto it = std::lower_bound(states.begin(), states.end(), index, [](const StateEntry& entry, uint16_t i) { return entry.index < i; });
+	return (it != states.end() && it->index == index) ? it->state : 0;
 }
 
-BlockId* Chunk::GetChunkCube(int lx, int ly, int lz) {
-	if (lx < 0) return nullptr;
-	if (ly < 0) return nullptr;
-	if (lz < 0) return nullptr;
-	if (lx >= CHUNK_SIZE) return nullptr;
-	if (ly >= CHUNK_SIZE) return nullptr;
-	if (lz >= CHUNK_SIZE) return nullptr;
-	return &data[lx + ly * CHUNK_SIZE + lz * CHUNK_SIZE * CHUNK_SIZE];
+void Chunk::SetState(int lx, int ly, int lz, BlockState state) {
+	if (states.empty() && state == 0) return;
+	uint16_t index = (uint16_t)GetLocalIndex(lx, ly, lz);
+	auto it = std::lower_bound(states.begin(), states.end(), index, [](const StateEntry& entry, uint16_t i) { return entry.index < i; });
+	bool found = it != states.end() && it->index == index;
+	if (state == 0) {
+		if (found) states.erase(it);
+	} else if (found) {
+		it->state = state;
+	} else {
+		states.insert(it, { index, state });
+	}
+	MarkVoxelDirty(lx, ly, lz, false);
 }
 
 void Chunk::PushCube(int lx, int ly, int lz) {
-	auto blockId = GetChunkCube(lx, ly, lz);
-	if (!blockId || *blockId == EMPTY) return;
-	auto& blockData = BlockData::Get(*blockId);
+	const Data& data = blocks.Read();
+	BlockId blockId = data[GetLocalIndex(lx, ly, lz)];
+	// the neighbours inside the chunk are read directly, the border ones through the neighbour chunks
+	const uint8_t faces = ChunkKernels<Dims>::GetVisibleFaces(data, lx, ly, lz, [&](int nx, int ny, int nz) -> const BlockId* {
+		int face = nx < 0 ? FACE_NEG_X : nx >= CHUNK_SIZE ? FACE_POS_X : ny < 0 ? FACE_NEG_Y : ny >= CHUNK_SIZE ? FACE_POS_Y : nz < 0 ? FACE_NEG_Z : FACE_POS_Z;
+		if (lodFaces & (1 << face)) return nullptr;
+		ChunkCursor cursor(this, nx, ny, nz);
+		return cursor.IsValid() ? cursor.GetCube() : nullptr;
+	});
+	if (!faces) return;
+	ShaderPass pass = BlockTables::GetPass(blockId);
 
 	float scaleY = 1.0f;
-	if (*blockId == WATER) {
-		auto blockIdNeighbour = world->GetCube(
-			cx * CHUNK_SIZE + lx,
-			cy * CHUNK_SIZE + ly + 1,
-			cz * CHUNK_SIZE + lz);
-		if (!blockIdNeighbour || *blockIdNeighbour == EMPTY)
-			scaleY = 0.8f;
+	if (BlockTables::GetFlags(blockId) & BF_GRAVITY_WATER) {
+		ChunkCursor above = ChunkCursor(this, lx, ly, lz).Neighbour(FACE_POS_Y);
+		// under water the column is full, otherwise the surface goes down with the level
+		if (!above.IsValid() || !GetWaterLevel(*above.GetCube()))
+			scaleY = 0.8f * GetWaterLevel(blockId) / WATER_SOURCE_LEVEL;
 	}
 
+	// side faces in the order below: +z, +x, -z, -x. A stateful block turns its front toward its facing
+	const BlockTables::FaceUV* sides[4];
+	std::fill(std::begin(sides), std::end(sides), &BlockTables::GetUV(blockId, BlockTables::TF_SIDE));
+	if (BlockTables::GetFlags(blockId) & BF_HAS_STATE) {
+		BlockState state = GetState(lx, ly, lz);
+		int facing = GetFacing(state);
+		const auto& front = BlockTables::GetStateUV(blockId, (state & BS_LIT) ? BlockTables::SF_FRONT_LIT : BlockTables::SF_FRONT);
+		std::fill(std::begin(sides), std::end(sides), &BlockTables::GetStateUV(blockId, BlockTables::SF_SIDE));
+		sides[facing] = &front;
+		if (GetStateTextures(blockId).frontAndBack) sides[(facing + 2) % 4] = &front;
+	}
+
+	const int voxel = GetLocalIndex(lx, ly, lz);
 	Vector3 offset = Vector3(lx, ly, lz + 1); // cf ExplicationOffset.png a la racine du projet!
-	if (ShouldRenderFace(lx, ly, lz, 0, 0, 1)) PushFace(offset + Vector3::Zero, Vector3::Up * scaleY, Vector3::Right, blockData.texIdSide, blockData.pass);
-	if (ShouldRenderFace(lx, ly, lz, 1, 0, 0)) PushFace(offset + Vector3::Right, Vector3::Up * scaleY, Vector3::Forward, blockData.texIdSide, blockData.pass);
-	if (ShouldRenderFace(lx, ly, lz, 0, 0, -1)) PushFace(offset + Vector3::Right + Vector3::Forward, Vector3::Up * scaleY, Vector3::Left, blockData.texIdSide, blockData.pass);
-	if (ShouldRenderFace(lx, ly, lz, -1, 0, 0)) PushFace(offset + Vector3::Forward, Vector3::Up * scaleY, Vector3::Backward, blockData.texIdSide, blockData.pass);
-	if (ShouldRenderFace(lx, ly, lz, 0, 1, 0)) PushFace(offset + Vector3::Up * scaleY, Vector3::Forward, Vector3::Right, blockData.texIdTop, blockData.pass);
-	if (ShouldRenderFace(lx, ly, lz, 0, -1, 0)) PushFace(offset + Vector3::Right + Vector3::Forward, Vector3::Left, Vector3::Backward, blockData.texIdBottom, blockData.pass);
-}
-
-void Chunk::PushFace(Vector3 pos, Vector3 up, Vector3 right, int texId, ShaderPass pass) {
-	Vector2 uv(
-		texId % 16,
-		texId / 16
-	);
-	Vector3 normal = up.Cross(right);
-	normal.Normalize();
-	uint32_t bottomLeft = vBuffer[pass].PushVertex(VertexLayout_PositionNormalUV(pos, normal, (uv + Vector2::UnitY) / 16.0f));
-	uint32_t bottomRight = vBuffer[pass].PushVertex(VertexLayout_PositionNormalUV(pos + right, normal, (uv + Vector2::One) / 16.0f));
-	uint32_t upLeft = vBuffer[pass].PushVertex(VertexLayout_PositionNormalUV(pos + up, normal, uv / 16.0f));
-	uint32_t upRight = vBuffer[pass].PushVertex(VertexLayout_PositionNormalUV(pos + up + right, normal, (uv + Vector2::UnitX) / 16.0f));
-	iBuffer[pass].PushTriangle(bottomLeft, upLeft, upRight);
-	iBuffer[pass].PushTriangle(bottomLeft, upRight, bottomRight);
+	if (faces & (1 << FACE_POS_Z)) RecordFace(voxel, 0, pass, PushFace(offset + Vector3::Zero, Vector3::Up * scaleY, Vector3::Right, Vector3::Forward, *sides[0], GetFaceLight(lx, ly, lz, 0, 0, 1), pass));
+	if (faces & (1 << FACE_POS_X)) RecordFace(voxel, 1, pass, PushFace(offset + Vector3::Right, Vector3::Up * scaleY, Vector3::Forward, Vector3::Left, *sides[1], GetFaceLight(lx, ly, lz, 1, 0, 0), pass));
+	if (faces & (1 << FACE_NEG_Z)) RecordFace(voxel, 2, pass, PushFace(offset + Vector3::Right + Vector3::Forward, Vector3::Up * scaleY, Vector3::Left, Vector3::Backward, *sides[2], GetFaceLight(lx, ly, lz, 0, 0, -1), pass));
+	if (faces & (1 << FACE_NEG_X)) RecordFace(voxel, 3, pass, PushFace(offset + Vector3::Forward, Vector3::Up * scaleY, Vector3::Backward, Vector3::Right, *sides[3], GetFaceLight(lx, ly, lz, -1, 0, 0), pass));
+	if (faces & (1 << FACE_POS_Y)) RecordFace(voxel, 4, pass, PushFace(offset + Vector3::Up * scaleY, Vector3::Forward, Vector3::Right, Vector3::Down, BlockTables::GetUV(blockId, BlockTables::TF_TOP), GetFaceLight(lx, ly, lz, 0, 1, 0), pass));
+	if (faces & (1 << FACE_NEG_Y)) RecordFace(voxel, 5, pass, PushFace(offset + Vector3::Right + Vector3::Forward, Vector3::Left, Vector3::Backward, Vector3::Up, BlockTables::GetUV(blockId, BlockTables::TF_BOTTOM), GetFaceLight(lx, ly, lz, 0, -1, 0), pass));
+}
+
+Vector2 Chunk::GetFaceLight(int lx, int ly, int lz, int dx, int dy, int dz) {
+	ChunkCursor cell(this, lx + dx, ly + dy, lz + dz);
+	// out of the world is open sky
+	uint8_t packed = cell.IsValid() ? *cell.GetLight() : (uint8_t)(Lighting::MAX_LIGHT << Lighting::SKY_SHIFT);
+	return Vector2(
+		((packed >> Lighting::SKY_SHIFT) & Lighting::MAX_LIGHT) / (float)Lighting::MAX_LIGHT,
+		((packed >> Lighting::BLOCK_SHIFT) & Lighting::MAX_LIGHT) / (float)Lighting::MAX_LIGHT);
+}
+
+// normal is up.Cross(right) normalized, known in advance for the 6 faces of a cube
+uint32_t Chunk::PushFace(Vector3 pos, Vector3 up, Vector3 right, Vector3 normal, const BlockTables::FaceUV& uv, Vector2 light, ShaderPass pass) {
+	const VertexLayout_PositionNormalUVLight vertices[4] = {
+		VertexLayout_PositionNormalUVLight(pos, normal, Vector2(uv.u0, uv.v1), light), // bottom left
+		VertexLayout_PositionNormalUVLight(pos + right, normal, Vector2(uv.u1, uv.v1), light), // bottom right
+		VertexLayout_PositionNormalUVLight(pos + up, normal, Vector2(uv.u0, uv.v0), light), // up left
+		VertexLayout_PositionNormalUVLight(pos + up + right, normal, Vector2(uv.u1, uv.v0), light), // up right
+	};
+	const uint32_t corners[6] = { 0, 2, 3, 0, 3, 1 };
+
+	if (!freeSlots[pass].empty()) {
+		uint32_t slot = freeSlots[pass].back();
+		freeSlots[pass].pop_back();
+		for (int i = 0; i < 4; i++)
+			vBuffer[pass].At(slot * 4 + i) = vertices[i];
+		for (int i = 0; i < 6; i++)
+			iBuffer[pass].At(slot * 6 + i) = slot * 4 + corners[i];
+		return slot;
+	}
+	uint32_t first = vBuffer[pass].Size();
+	for (int i = 0; i < 4; i++)
+		vBuffer[pass].PushVertex(vertices[i]);
+	iBuffer[pass].PushTriangle(first + corners[0], first + corners[1], first + corners[2]);
+	iBuffer[pass].PushTriangle(first + corners[3], first + corners[4], first + corners[5]);
+	return first / 4;
+}
+
+void Chunk::RecordFace(int voxel, int face, ShaderPass pass, uint32_t slot) {
+	static_assert(SP_COUNT <= 2, "the pass is one bit of the record");
+	if (faceSlots.empty()) return;
+	faceSlots[voxel * 6 + face] = (uint16_t)(pass << 15 | (slot + 1));
+}
+
+// the slots go to the free list, their triangles collapse to a point until reused
+void Chunk::RemoveFaces(int voxel) {
+	for (int face = 0; face < 6; face++) {
+		uint16_t& record = faceSlots[voxel * 6 + face];
+		if (record == 0) continue;
+		int pass = record >> 15;
+		uint32_t slot = (record & 0x7fff) - 1;
+		for (int i = 0; i < 6; i++)
+			iBuffer[pass].At(slot * 6 + i) = slot * 4;
+		freeSlots[pass].push_back(slot);
+		record = 0;
+	}
 }
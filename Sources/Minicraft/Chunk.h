@@ -3,7 +3,10 @@
 #include "Engine/Buffer.h"
 #include "Engine/VertexLayout.h"
 #include "Block.h"
+#include "ChunkDims.h"
+#include "ChunkSnapshot.h"
 #include <array>
+#include <bitset>
 
 using namespace DirectX;
 using namespace DirectX::SimpleMath;
@@ -11,29 +14,170 @@ class World;
 
 class Chunk {
 public:
-	constexpr static int CHUNK_SIZE = 8;
+	using Dims = ChunkDims<8>;
+	constexpr static int CHUNK_SIZE = Dims::SIZE;
+	using Data = Dims::Data;
+	using Snapshot = ChunkSnapshot<Dims>;
+
+	enum Face {
+		FACE_NEG_X, FACE_POS_X,
+		FACE_NEG_Y, FACE_POS_Y,
+		FACE_NEG_Z, FACE_POS_Z,
+
+		FACE_COUNT
+	};
+	static constexpr int FACE_DIRS[FACE_COUNT][3] = {
+		{ -1, 0, 0 }, { 1, 0, 0 },
+		{ 0, -1, 0 }, { 0, 1, 0 },
+		{ 0, 0, -1 }, { 0, 0, 1 },
+	};
+	static Face OppositeFace(int face) { return (Face)(face ^ 1); }
+	struct StateEntry {
+		uint16_t index;
+		BlockState state;
+	};
 private:
-	std::array<BlockId, CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE> data;
-	VertexBuffer<VertexLayout_PositionNormalUV> vBuffer[SP_COUNT];
+	ChunkBlocks<Dims> blocks; // copy-on-write while a snapshot holds them
+	std::vector<StateEntry> states; // sorted by local index, only the cubes with a non zero state
+	std::array<uint8_t, CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE> light = {}; // sky << 4 | block, written by Lighting
+	VertexBuffer<VertexLayout_PositionNormalUVLight> vBuffer[SP_COUNT];
 	IndexBuffer iBuffer[SP_COUNT];
+	// Face records for PatchMesh: per voxel face (local index * 6 + face in PushCube order), pass << 15 | slot + 1,
+	// 0 when the face isn't drawn. A slot is 4 vertices and 6 indices. Only allocated once the chunk gets edited
+	std::vector<uint16_t> faceSlots;
+	std::vector<uint32_t> freeSlots[SP_COUNT]; // slots of removed faces, degenerate until reused
+	std::vector<uint16_t> patchVoxels; // local indices whose faces PatchMesh re-emits
+	std::bitset<CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE> patchMask;
+	// box of the voxels marked since the last mesh update, inclusive. Past PATCH_LIMIT voxels the list is dropped
+	// and PatchMesh re-emits the whole box instead, up to half the chunk
+	int regionMin[3] = { CHUNK_SIZE, CHUNK_SIZE, CHUNK_SIZE }, regionMax[3] = { -1, -1, -1 };
+	bool regionPatch = false;
+	uint32_t meshVersion = 0; // bumped by every change of the CPU mesh
+	uint8_t createUploads = 0, patchUploads = 0; // per pass, how the device buffers catch up with the CPU mesh
 	BoundingBox bounds;
 	Matrix mModel;
 	World* world;
+	Chunk* neighbours[FACE_COUNT] = {}; // across each face, nullptr on the border of the world
+	uint8_t lodFaces = 0; // bit per face whose neighbour is drawn by a LOD node, meshed like the border of the world
 	int cx, cy, cz;
 	bool dirty = true;
+	bool visibilityDirty = true;
+	uint64_t connectivity = 0; // bit a * FACE_COUNT + b: face a can see face b through non-opaque voxels
+	uint32_t fullLayers[3] = {}; // per axis, bit per layer of the chunk that is fully opaque, used as occluders
+	bool hasCollision = true; // some voxel has a physics shape
+	bool empty = false; // every voxel is EMPTY
+	bool persistDirty = false;
+	uint32_t version = 0;
 public:
 	Chunk() = default;
 
-	void MarkDirty() { dirty = true; }
+	constexpr static int PATCH_LIMIT = 64; // voxels, past that the dirty box is patched
+	constexpr static int COMPACT_PERCENT = 25; // free slots of a pass that trigger a rebuild
+
+	void MarkDirty() { dirty = true; visibilityDirty = true; }
+	// only the faces of this voxel change, blocksChanged when its block did (the connectivity is recomputed)
+	void MarkVoxelDirty(int lx, int ly, int lz, bool blocksChanged);
+	bool IsDirty() const { return dirty; }
+	bool NeedsMeshUpdate() const { return dirty || regionPatch || !patchVoxels.empty(); }
+	// voxels the next mesh update re-emits
+	int GetPendingVoxels() const;
+	// allocates the face records (rebuilding the mesh once) so the next edits are patched
+	void AllocateFaceRecords() {
+		if (!faceSlots.empty()) return;
+		faceSlots.assign(CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE * 6, 0);
+		dirty = true;
+	}
+	void ClearDirty() { dirty = false; ResetPatches(); }
+	// returns true the first time the chunk becomes persist-dirty since the last snapshot
+	bool MarkPersistDirty() { version++; bool wasDirty = persistDirty; persistDirty = true; return !wasDirty; }
+	void ClearPersistDirty() { persistDirty = false; }
+	bool IsPersistDirty() const { return persistDirty; }
+	uint32_t GetVersion() const { return version; }
+	const Data& GetData() const { return blocks.Read(); }
+	void SetData(const Data& newData) { blocks.Write() = newData; states.clear(); MarkDirty(); }
+	// the blocks as they are now, kept by the snapshot whatever the chunk becomes. Main thread only
+	Snapshot GetSnapshot() const { return blocks.Share(version); }
+	int GetCloneCount() const { return blocks.GetCloneCount(); }
 	void SetPosition(World* world, int cx, int cy, int cz);
+	// linked once by World, its chunks live as long as it does
+	void SetNeighbour(int face, Chunk* chunk) { neighbours[face] = chunk; }
+	Chunk* GetNeighbour(int face) const { return neighbours[face]; }
+	// the coarse cells of a LOD node may not hide the faces toward it: a change of faces remeshes the chunk
+	void SetLodFaces(uint8_t faces) {
+		if (faces == lodFaces) return;
+		lodFaces = faces;
+		dirty = true;
+	}
 	void Generate(DeviceResources* deviceRes);
+	// CPU side of Generate: fills the vertex and index arrays, no device needed
+	void BuildMesh();
+	// re-emits the faces of the voxels marked by MarkVoxelDirty in their slots, no device needed.
+	// Returns false when it compacted the mesh with a full BuildMesh instead
+	bool PatchMesh();
+	// CPU side of Draw: BuildMesh or PatchMesh, whichever is due
+	void UpdateMesh();
+	uint32_t GetMeshVersion() const { return meshVersion; }
+	const std::vector<VertexLayout_PositionNormalUVLight>& GetVertices(ShaderPass pass) const { return vBuffer[pass].GetData(); }
+	const std::vector<uint32_t>& GetIndices(ShaderPass pass) const { return iBuffer[pass].GetData(); }
 	void Draw(DeviceResources* deviceRes, ShaderPass pass);
 	const BoundingBox& GetBounds() const { return bounds; }
 	const Matrix& GetLocalMatrix() const { return mModel; }
+	int GetTriangleCount() {
+		int triangles = 0;
+		for (int pass = SP_OPAQUE; pass < SP_COUNT; pass++)
+			triangles += iBuffer[pass].Size() / 3;
+		return triangles;
+	}
+
+	// order independent hash of the faces drawn, a patched mesh and a rebuild of the same blocks hash the same
+	uint64_t HashFaces();
+
+	// face-to-face connectivity, recomputed lazily so it can be queried without a device
+	void UpdateVisibility();
+	bool AreFacesConnected(int faceA, int faceB) {
+		if (visibilityDirty) UpdateVisibility();
+		return connectivity & (1ull << (faceA * FACE_COUNT + faceB));
+	}
+	// false when nothing in the chunk can collide, lets the physics skip it
+	bool HasCollision() {
+		if (visibilityDirty) UpdateVisibility();
+		return hasCollision;
+	}
+	bool IsEmpty() {
+		if (visibilityDirty) UpdateVisibility();
+		return empty;
+	}
+	// every voxel is opaque
+	bool IsFull() {
+		if (visibilityDirty) UpdateVisibility();
+		return fullLayers[1] == (1u << CHUNK_SIZE) - 1;
+	}
+	// the longest run of fully opaque layers along each axis as boxes (one for a full chunk), returns their count
+	int GetOccluders(Vector3 boxMin[3], Vector3 boxMax[3]);
 
-	BlockId* GetChunkCube(int cx, int cy, int cz);
+	// writable: a snapshot outstanding makes the chunk clone its blocks, don't keep the pointer over a snapshot
+	BlockId* GetChunkCube(int lx, int ly, int lz);
+	const BlockId* GetChunkCube(int lx, int ly, int lz) const;
+	uint8_t* GetChunkLight(int lx, int ly, int lz) { return &light[GetLocalIndex(lx, ly, lz)]; }
+	// sparse block states: a chunk without stateful blocks pays for an empty vector
+	BlockState GetState(int lx, int ly, int lz) const;
+	void SetState(int lx, int ly, int lz, BlockState state); // 0 drops the entry
+	void ClearStates() { states.clear(); }
+	int GetStateCount() const { return (int)states.size(); }
+	const std::vector<StateEntry>& GetStates() const { return states; }
+	size_t GetStateMemory() const { return sizeof(states) + states.capacity() * sizeof(StateEntry); }
+	static int GetLocalIndex(int lx, int ly, int lz) { return Dims::Index(lx, ly, lz); }
 private:
-	bool ShouldRenderFace(int cx, int cy, int cz, int dx, int dy, int dz);
 	void PushCube(int cx, int cy, int cz);
-	void PushFace(Vector3 pos, Vector3 up, Vector3 right, int texId, ShaderPass pass);
+	// a face is lit by the cell it looks at
+	Vector2 GetFaceLight(int lx, int ly, int lz, int dx, int dy, int dz);
+	// writes the face in a free slot or appends it, returns the slot
+	uint32_t PushFace(Vector3 pos, Vector3 up, Vector3 right, Vector3 normal, const BlockTables::FaceUV& uv, Vector2 light, ShaderPass pass);
+	void RecordFace(int voxel, int face, ShaderPass pass, uint32_t slot);
+	void RemoveFaces(int voxel);
+	void RepushVoxel(int voxel);
+	// full and so are its 6 neighbours: no face can show
+	bool IsEnclosed();
+	void Upload(DeviceResources* deviceRes, ShaderPass pass);
+	void ResetPatches();
 };
\ No newline at end of file
@@ -0,0 +1,113 @@
+#include "pch.h"
+
+#include "ChunkBatch.h"
+#include "World.h"
+
+// faces a brick range can hold: a quarter more than today plus a few, nothing for an empty brick
+static uint32_t GetCapacity(uint32_t faces, bool empty) {
+	if (empty && faces == 0) return 0;
+	return faces + faces / 4 + 8;
+}
+
+void ChunkBatch::SetPosition(World* world, int bx, int by, int bz) {
+	for (int z = 0; z < BRICKS; z++)
+		for (int y = 0; y < BRICKS; y++)
+			for (int x = 0; x < BRICKS; x++)
+				bricks[GetBrickIndex(x, y, z)] = &world->GetChunkByIndex(World::GetChunkIndex(bx * BRICKS + x, by * BRICKS + y, bz * BRICKS + z));
+	mModel = Matrix::CreateTranslation(Vector3(bx, by, bz) * (BRICKS * Chunk::CHUNK_SIZE));
+	layoutDirty = true;
+}
+
+void ChunkBatch::UpdateMesh() {
+	for (int brick = 0; brick < BRICK_COUNT; brick++) {
+		Chunk* chunk = bricks[brick];
+		if (chunk->NeedsMeshUpdate()) chunk->UpdateMesh();
+		Range& range = ranges[brick];
+		if (layoutDirty || chunk->GetMeshVersion() == range.meshVersion) continue;
+		if (chunk->GetVertices(SP_OPAQUE).size() > range.vertexCapacity) {
+			layoutDirty = true;
+			continue;
+		}
+		WriteBrick(brick);
+		uploads[brick] = true;
+		stats.brickWrites++;
+	}
+	if (layoutDirty) Relayout();
+}
+
+int ChunkBatch::PlanDraws(const BrickMask& visible) {
+	draws.clear();
+	for (int brick = 0; brick < BRICK_COUNT; brick++) {
+		const Range& range = ranges[brick];
+		if (!visible[brick] || range.indexCapacity == 0 || bricks[brick]->GetIndices(SP_OPAQUE).empty()) continue;
+		// the ranges follow each other in brick order: extend the last call when it ends where this one starts
+		if (!draws.empty() && draws.back().first + draws.back().second == range.firstIndex)
+			draws.back().second += range.indexCapacity;
+		else
+			draws.push_back({ range.firstIndex, range.indexCapacity });
+	}
+	return (int)draws.size();
+}
+
+int ChunkBatch::Draw(DeviceResources* deviceRes, const BrickMask& visible) {
+	UpdateMesh();
+	if (bufferDirty) {
+		vBuffer.Create(deviceRes);
+		iBuffer.Create(deviceRes);
+		bufferDirty = false;
+	} else {
+		for (int brick = 0; brick < BRICK_COUNT; brick++) {
+			if (!uploads[brick]) continue;
+			const Range& range = ranges[brick];
+			vBuffer.UpdateRange(deviceRes, range.firstVertex, range.vertexCapacity);
+			iBuffer.UpdateRange(deviceRes, range.firstIndex, range.indexCapacity);
+		}
+	}
+	uploads.reset();
+
+	if (PlanDraws(visible) == 0) return 0;
+	vBuffer.Apply(deviceRes);
+	iBuffer.Apply(deviceRes);
+	for (auto& draw : draws)
+		deviceRes->GetD3DDeviceContext()->DrawIndexed(draw.second, draw.first, 0);
+	return (int)draws.size();
+}
+
+void ChunkBatch::Relayout() {
+	uint32_t vertexCount = 0, indexCount = 0;
+	for (int brick = 0; brick < BRICK_COUNT; brick++) {
+		Range& range = ranges[brick];
+		uint32_t faces = GetCapacity((uint32_t)bricks[brick]->GetVertices(SP_OPAQUE).size() / 4, bricks[brick]->IsEmpty());
+		range.firstVertex = vertexCount;
+		range.vertexCapacity = faces * 4;
+		range.firstIndex = indexCount;
+		range.indexCapacity = faces * 6;
+		vertexCount += range.vertexCapacity;
+		indexCount += range.indexCapacity;
+	}
+	vBuffer.Resize(vertexCount);
+	iBuffer.Resize(indexCount);
+	for (int brick = 0; brick < BRICK_COUNT; brick++)
+		WriteBrick(brick);
+	layoutDirty = false;
+	bufferDirty = true;
+	uploads.reset();
+	stats.relayouts++;
+}
+
+// the vertices move from the brick to the batch space, the spare indices of the range collapse on its first vertex
+void ChunkBatch::WriteBrick(int brick) {
+	Range& range = ranges[brick];
+	const Chunk* chunk = bricks[brick];
+	const auto& vertices = chunk->GetVertices(SP_OPAQUE);
+	const auto& indices = chunk->GetIndices(SP_OPAQUE);
+	const Vector3 offset = Vector3(brick % BRICKS, (brick / BRICKS) % BRICKS, brick / (BRICKS * BRICKS)) * Chunk::CHUNK_SIZE;
+	for (uint32_t i = 0; i < vertices.size(); i++) {
+		VertexLayout_PositionNormalUVLight& vertex = vBuffer.At(range.firstVertex + i);
+		vertex = vertices[i];
+		vertex.position += offset;
+	}
+	for (uint32_t i = 0; i < range.indexCapacity; i++)
+		iBuffer.At(range.firstIndex + i) = range.firstVertex + (i < indices.size() ? indices[i] : 0);
+	range.meshVersion = chunk->GetMeshVersion();
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Engine/Buffer.h"
+#include "Engine/VertexLayout.h"
+#include "Chunk.h"
+#include <bitset>
+#include <vector>
+
+class World;
+
+// Opaque pass of BRICKS^3 chunks drawn from one vertex and index buffer. The chunks stay the unit of meshing,
+// culling and persistence (the bricks); the batch copies each brick mesh into its own range of the buffers,
+// with some slack so an edit usually rewrites that range only. The visible bricks are drawn with one call per
+// run of consecutive ranges.
+class ChunkBatch {
+public:
+	constexpr static int BRICKS = 4; // chunks per axis
+	constexpr static int BRICK_COUNT = BRICKS * BRICKS * BRICKS;
+	using BrickMask = std::bitset<BRICK_COUNT>;
+	struct Stats {
+		int relayouts = 0; // whole buffers rebuilt because a brick outgrew its range
+		int brickWrites = 0; // brick ranges rewritten in place
+	};
+private:
+	struct Range {
+		uint32_t firstVertex = 0, vertexCapacity = 0;
+		uint32_t firstIndex = 0, indexCapacity = 0;
+		uint32_t meshVersion = UINT32_MAX; // of the brick mesh copied, never a real one at first
+	};
+	VertexBuffer<VertexLayout_PositionNormalUVLight> vBuffer;
+	IndexBuffer iBuffer;
+	Chunk* bricks[BRICK_COUNT] = {};
+	Range ranges[BRICK_COUNT];
+	BrickMask uploads; // brick ranges rewritten since the last Draw
+	bool layoutDirty = true;
+	bool bufferDirty = true; // the device buffers must be created again
+	std::vector<std::pair<uint32_t, uint32_t>> draws; // first index and count, from the last PlanDraws
+	Matrix mModel;
+	Stats stats;
+public:
+	void SetPosition(World* world, int bx, int by, int bz);
+	// brings the brick meshes and their ranges up to date, no device needed
+	void UpdateMesh();
+	// index ranges drawn for the visible bricks, returns the number of draw calls
+	int PlanDraws(const BrickMask& visible);
+	// returns the number of draw calls
+	int Draw(DeviceResources* deviceRes, const BrickMask& visible);
+
+	// batch and brick of a chunk, in chunk coordinates
+	static int GetBrickIndex(int cx, int cy, int cz) {
+		return cx % BRICKS + (cy % BRICKS) * BRICKS + (cz % BRICKS) * BRICKS * BRICKS;
+	}
+	const Matrix& GetLocalMatrix() const { return mModel; }
+	uint32_t GetVertexCount() const { return vBuffer.Size(); }
+	const Stats& GetStats() const { return stats; }
+private:
+	void Relayout();
+	void WriteBrick(int brick);
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Chunk.h"
+#include <utility>
+
+// A voxel of a chunk that steps to the voxels around it through the chunk links, without going back to world
+// coordinates. Past the border of the world the cursor has no chunk.
+class ChunkCursor {
+	Chunk* chunk = nullptr;
+	int local[3] = {};
+public:
+	ChunkCursor() = default;
+	// local coordinates may be anywhere around the chunk, one link is followed per chunk crossed
+	ChunkCursor(Chunk* origin, int lx, int ly, int lz) : chunk(origin), local{ lx, ly, lz } {
+		for (int axis = 0; axis < 3; axis++) {
+			while (chunk && local[axis] < 0) {
+				chunk = chunk->GetNeighbour(axis * 2);
+				local[axis] += Chunk::CHUNK_SIZE;
+			}
+			while (chunk && local[axis] >= Chunk::CHUNK_SIZE) {
+				chunk = chunk->GetNeighbour(axis * 2 + 1);
+				local[axis] -= Chunk::CHUNK_SIZE;
+			}
+		}
+	}
+
+	bool IsValid() const { return chunk != nullptr; }
+	Chunk* GetChunk() const { return chunk; }
+	int GetLocalX() const { return local[0]; }
+	int GetLocalY() const { return local[1]; }
+	int GetLocalZ() const { return local[2]; }
+	// read only, the chunk doesn't clone its blocks for it
+	const BlockId* GetCube() const { return std::as_const(*chunk).GetChunkCube(local[0], local[1], local[2]); }
+	uint8_t* GetLight() const { return chunk->GetChunkLight(local[0], local[1], local[2]); }
+
+	// the voxel across a face (Chunk::Face)
+	ChunkCursor Neighbour(int face) const {
+		ChunkCursor next = *this;
+		const int axis = face >> 1;
+		next.local[axis] += Chunk::FACE_DIRS[face][axis];
+		if (!Chunk::Dims::IsInside(next.local[axis])) {
+			next.chunk = chunk->GetNeighbour(face);
+			next.local[axis] = Chunk::Dims::ToLocal(next.local[axis]);
+		}
+		return next;
+	}
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Block.h"
+#include <array>
+
+// Order of the cells of a SIZE^3 grid, SIZE = 1 << SHIFT
+
+// x fastest, then y, then z
+template<int SHIFT>
+struct LinearLayout {
+	static constexpr int Index(int x, int y, int z) { return x | y << SHIFT | z << (2 * SHIFT); }
+	static constexpr int IndexX(int index) { return index & ((1 << SHIFT) - 1); }
+	static constexpr int IndexY(int index) { return (index >> SHIFT) & ((1 << SHIFT) - 1); }
+	static constexpr int IndexZ(int index) { return index >> (2 * SHIFT); }
+};
+
+// Z-order: the bits of x, y and z interleave (x in bit 0), so every aligned 2^n cube is contiguous and a
+// neighbour along y or z is near instead of a row or a slice away. Encoding goes through a table of the spread
+// bits rather than BMI2 pdep, which the x64 target doesn't assume; decoding packs every third bit back.
+template<int SHIFT>
+struct MortonLayout {
+	static_assert(SHIFT <= 7, "morton tables cover 128 cells per axis");
+
+	static constexpr std::array<int, 1 << SHIFT> MakeSpread() {
+		std::array<int, 1 << SHIFT> spread = {};
+		for (int v = 0; v < (1 << SHIFT); v++)
+			for (int bit = 0; bit < SHIFT; bit++)
+				spread[v] |= ((v >> bit) & 1) << (3 * bit);
+		return spread;
+	}
+	static constexpr std::array<int, 1 << SHIFT> SPREAD = MakeSpread();
+	static constexpr int Compact(int bits) {
+		unsigned v = (unsigned)bits & 0x09249249u;
+		v = (v ^ (v >> 2)) & 0x030c30c3u;
+		v = (v ^ (v >> 4)) & 0x0300f00fu;
+		v = (v ^ (v >> 8)) & 0xff0000ffu;
+		v = (v ^ (v >> 16)) & 0x000003ffu;
+		return (int)v;
+	}
+
+	static constexpr int Index(int x, int y, int z) { return SPREAD[x] | SPREAD[y] << 1 | SPREAD[z] << 2; }
+	static constexpr int IndexX(int index) { return Compact(index); }
+	static constexpr int IndexY(int index) { return Compact(index >> 1); }
+	static constexpr int IndexZ(int index) { return Compact(index >> 2); }
+};
+
+// Compile time chunk dimensions: a power of two side, so the global to chunk / local conversions are shifts
+// and masks, and the order of the cells. Chunk uses ChunkDims<8> and World its chunk grid the same way:
+// ChunkDims<8, MortonLayout> there switches the voxels to Z-order (saved chunks keep the order they were
+// written in). The kernels of ChunkKernels.h and WorldGenerator::GenerateChunk are instantiated for other sizes
+// and layouts to compare them headless.
+template<int SIDE, template<int> class Layout = LinearLayout>
+struct ChunkDims {
+	static_assert(SIDE >= 2 && (SIDE & (SIDE - 1)) == 0, "chunk side must be a power of two");
+
+	constexpr static int SIZE = SIDE;
+	constexpr static int SHIFT = SIDE == 2 ? 1 : SIDE == 4 ? 2 : SIDE == 8 ? 3 : SIDE == 16 ? 4 : SIDE == 32 ? 5 : SIDE == 64 ? 6 : 7;
+	constexpr static int MASK = SIDE - 1;
+	constexpr static int VOLUME = SIDE * SIDE * SIDE;
+	static_assert((1 << SHIFT) == SIDE, "chunk side out of range");
+	using Data = std::array<BlockId, VOLUME>;
+	using Order = Layout<SHIFT>;
+
+	static constexpr int Index(int lx, int ly, int lz) { return Order::Index(lx, ly, lz); }
+	static constexpr int IndexX(int index) { return Order::IndexX(index); }
+	static constexpr int IndexY(int index) { return Order::IndexY(index); }
+	static constexpr int IndexZ(int index) { return Order::IndexZ(index); }
+	// global block coordinate to chunk and local, negative coordinates land in negative chunks
+	static constexpr int ToChunk(int g) { return g >> SHIFT; }
+	static constexpr int ToLocal(int g) { return g & MASK; }
+	static constexpr bool IsInside(int l) { return (unsigned)l < (unsigned)SIDE; }
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Chunk.h"
+#include <bitset>
+
+// Inner loops of the chunk mesher, on any ChunkDims. The cells inside the chunk are read from its data,
+// outside(lx, ly, lz) gives the others (local coordinates past the chunk) and returns nullptr out of the world.
+template<class Dims>
+struct ChunkKernels {
+	// bit per Chunk::Face of the faces of the voxel a neighbour doesn't hide, 0 for an empty voxel
+	template<class Outside>
+	static uint8_t GetVisibleFaces(const typename Dims::Data& data, int lx, int ly, int lz, Outside&& outside) {
+		BlockId id = data[Dims::Index(lx, ly, lz)];
+		if (id == EMPTY) return 0;
+		uint8_t faces = 0;
+		for (int face = 0; face < Chunk::FACE_COUNT; face++) {
+			int nx = lx + Chunk::FACE_DIRS[face][0];
+			int ny = ly + Chunk::FACE_DIRS[face][1];
+			int nz = lz + Chunk::FACE_DIRS[face][2];
+			const BlockId* neighbour = Dims::IsInside(nx) && Dims::IsInside(ny) && Dims::IsInside(nz)
+				? &data[Dims::Index(nx, ny, nz)] : outside(nx, ny, nz);
+			if (!neighbour || !BlockTables::Hides(id, *neighbour)) faces |= 1 << face;
+		}
+		return faces;
+	}
+
+	// emit(lx, ly, lz, faces) for every voxel showing a face, in the order of the data, returns the number of faces
+	template<class Outside, class Emit>
+	static int Mesh(const typename Dims::Data& data, Outside&& outside, Emit&& emit) {
+		int count = 0;
+		for (int index = 0; index < Dims::VOLUME; index++) {
+			if (data[index] == EMPTY) continue;
+			int lx = Dims::IndexX(index), ly = Dims::IndexY(index), lz = Dims::IndexZ(index);
+			uint8_t faces = GetVisibleFaces(data, lx, ly, lz, outside);
+			if (!faces) continue;
+			emit(lx, ly, lz, faces);
+			count += (int)std::bitset<Chunk::FACE_COUNT>(faces).count();
+		}
+		return count;
+	}
+};
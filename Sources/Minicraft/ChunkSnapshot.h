@@ -0,0 +1,80 @@
+#pragma once
+
+#include "ChunkDims.h"
+#include <atomic>
+#include <utility>
+
+// One version of the blocks of a chunk, freed by its last reference
+template<class Dims>
+struct ChunkVersion {
+	inline static std::atomic<int> live{ 0 }; // versions allocated, for the stress benchmark
+	std::atomic<int> refs{ 1 };
+	typename Dims::Data data = {};
+
+	ChunkVersion() { live.fetch_add(1, std::memory_order_relaxed); }
+	~ChunkVersion() { live.fetch_sub(1, std::memory_order_relaxed); }
+};
+
+// Immutable blocks of a chunk. Taken in O(1) by the thread that writes the world (Chunk::GetSnapshot), then read,
+// copied and dropped on any thread without a lock: while a snapshot holds the blocks, the next write to the chunk
+// clones them first. Light and block states aren't part of it.
+template<class Dims>
+class ChunkSnapshot {
+	template<class> friend class ChunkBlocks;
+	ChunkVersion<Dims>* shared = nullptr;
+	uint32_t version = 0; // of the chunk when taken
+
+	ChunkSnapshot(ChunkVersion<Dims>* shared, uint32_t version) : shared(shared), version(version) {}
+	void Release() {
+		// acq_rel: the last owner sees every read of the others before freeing, the writer sees them before writing
+		if (shared && shared->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete shared;
+		shared = nullptr;
+	}
+public:
+	ChunkSnapshot() = default;
+	// holding a reference already, so the count can't be seen at 1 by the writer meanwhile
+	ChunkSnapshot(const ChunkSnapshot& other) : shared(other.shared), version(other.version) {
+		if (shared) shared->refs.fetch_add(1, std::memory_order_relaxed);
+	}
+	ChunkSnapshot(ChunkSnapshot&& other) noexcept : shared(std::exchange(other.shared, nullptr)), version(other.version) {}
+	ChunkSnapshot& operator=(ChunkSnapshot other) noexcept {
+		std::swap(shared, other.shared);
+		version = other.version;
+		return *this;
+	}
+	~ChunkSnapshot() { Release(); }
+
+	bool IsValid() const { return shared != nullptr; }
+	uint32_t GetVersion() const { return version; }
+	const typename Dims::Data& GetData() const { return shared->data; }
+	BlockId GetCube(int lx, int ly, int lz) const { return shared->data[Dims::Index(lx, ly, lz)]; }
+};
+
+// The blocks a chunk owns: written in place while nothing else holds them, cloned first otherwise.
+// Copying shares them the same way
+template<class Dims>
+class ChunkBlocks {
+	ChunkSnapshot<Dims> head;
+	int clones = 0; // writes that had to copy the blocks
+public:
+	ChunkBlocks() : head(new ChunkVersion<Dims>(), 0) {}
+
+	const typename Dims::Data& Read() const { return head.shared->data; }
+	typename Dims::Data& Write() {
+		// acquire: the reads of snapshots dropped on other threads are done before this write
+		if (head.shared->refs.load(std::memory_order_acquire) != 1) {
+			ChunkVersion<Dims>* copy = new ChunkVersion<Dims>();
+			copy->data = head.shared->data;
+			head = ChunkSnapshot<Dims>(copy, 0);
+			clones++;
+		}
+		return head.shared->data;
+	}
+	// on the writing thread only: a reader can't take a reference while Write checks the count
+	ChunkSnapshot<Dims> Share(uint32_t version) const {
+		ChunkSnapshot<Dims> snapshot = head;
+		snapshot.version = version;
+		return snapshot;
+	}
+	int GetCloneCount() const { return clones; }
+};
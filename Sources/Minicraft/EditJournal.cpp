@@ -0,0 +1,109 @@
+#include "pch.h"
+
+#include "EditJournal.h"
+
+constexpr size_t FRAME_HEADER_SIZE = 3 * sizeof(uint32_t);
+
+static void PushVarint(std::vector<uint8_t>& out, int value) {
+	uint32_t zigzag = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+	while (zigzag >= 0x80) {
+		out.push_back((uint8_t)(zigzag | 0x80));
+		zigzag >>= 7;
+	}
+	out.push_back((uint8_t)zigzag);
+}
+
+static bool ReadVarint(const uint8_t*& cursor, const uint8_t* end, int& value) {
+	uint32_t zigzag = 0;
+	for (int shift = 0; shift < 35; shift += 7) {
+		if (cursor >= end) return false;
+		uint8_t byte = *cursor++;
+		zigzag |= (uint32_t)(byte & 0x7F) << shift;
+		if (!(byte & 0x80)) {
+			value = (int)(zigzag >> 1) ^ -(int)(zigzag & 1);
+			return true;
+		}
+	}
+	return false;
+}
+
+// FNV-1a, only there to detect a torn write
+static uint32_t Checksum(const uint8_t* data, size_t size) {
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static void PushU32(std::vector<uint8_t>& out, uint32_t v) {
+	out.insert(out.end(), reinterpret_cast<uint8_t*>(&v), reinterpret_cast<uint8_t*>(&v) + sizeof(v));
+}
+
+void EditJournal::Append(const BlockEdit& edit) {
+	PushVarint(payload, edit.gx - last[0]);
+	PushVarint(payload, edit.gy - last[1]);
+	PushVarint(payload, edit.gz - last[2]);
+	payload.push_back(edit.id);
+	if (BlockTables::GetFlags(edit.id) & BF_HAS_STATE) payload.push_back(edit.state);
+	last[0] = edit.gx;
+	last[1] = edit.gy;
+	last[2] = edit.gz;
+	count++;
+}
+
+void EditJournal::SealFrame(std::vector<uint8_t>& out) {
+	if (count == 0) return;
+	PushU32(out, (uint32_t)payload.size());
+	PushU32(out, count);
+	PushU32(out, Checksum(payload.data(), payload.size()));
+	out.insert(out.end(), payload.begin(), payload.end());
+	Clear();
+}
+
+void EditJournal::Clear() {
+	payload.clear();
+	count = 0;
+	last[0] = last[1] = last[2] = 0;
+}
+
+size_t EditJournal::Decode(const std::vector<uint8_t>& file, std::vector<BlockEdit>& out) {
+	size_t offset = 0;
+	while (offset + FRAME_HEADER_SIZE <= file.size()) {
+		const uint32_t* header = reinterpret_cast<const uint32_t*>(&file[offset]);
+		uint32_t size = header[0];
+		uint32_t frameCount = header[1];
+		if (offset + FRAME_HEADER_SIZE + size > file.size()) break;
+		const uint8_t* cursor = &file[offset + FRAME_HEADER_SIZE];
+		const uint8_t* end = cursor + size;
+		if (Checksum(cursor, size) != header[2]) break;
+
+		size_t firstEdit = out.size();
+		int pos[3] = { 0, 0, 0 };
+		bool valid = true;
+		for (uint32_t i = 0; i < frameCount && valid; i++) {
+			int delta[3];
+			valid = ReadVarint(cursor, end, delta[0]) && ReadVarint(cursor, end, delta[1]) && ReadVarint(cursor, end, delta[2]) && cursor < end;
+			if (!valid) break;
+			BlockId id = (BlockId)*cursor++;
+			valid = id < COUNT;
+			if (!valid) break;
+			BlockState state = 0;
+			if (BlockTables::GetFlags(id) & BF_HAS_STATE) {
+				valid = cursor < end;
+				if (!valid) break;
+				state = *cursor++;
+			}
+			for (int axis = 0; axis < 3; axis++)
+				pos[axis] += delta[axis];
+			out.push_back({ pos[0], pos[1], pos[2], id, state });
+		}
+		if (!valid || cursor != end) {
+			out.resize(firstEdit);
+			break;
+		}
+		offset += FRAME_HEADER_SIZE + size;
+	}
+	return offset;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "World.h"
+
+// Append-only log of gameplay block edits, cheap enough to be made durable every few hundred ms.
+// Edits are grouped in frames: [u32 payload size][u32 edit count][u32 checksum][payload]
+// where each edit is the zigzag varint delta of its coordinates to the previous edit of the frame, then the block id,
+// then the block state for a block with BF_HAS_STATE.
+// A crash can only tear the last frame, Replay stops there.
+class EditJournal {
+	std::vector<uint8_t> payload;
+	uint32_t count = 0;
+	int last[3] = { 0, 0, 0 };
+public:
+	void Append(const BlockEdit& edit);
+	bool IsEmpty() const { return count == 0; }
+	uint32_t GetCount() const { return count; }
+
+	// moves the pending edits into a frame appended to out, the next frame restarts its deltas from 0
+	void SealFrame(std::vector<uint8_t>& out);
+	void Clear();
+
+	// decodes every valid frame of a journal file, returns the number of bytes that were valid
+	static size_t Decode(const std::vector<uint8_t>& file, std::vector<BlockEdit>& out);
+};
@@ -0,0 +1,325 @@
+#include "pch.h"
+
+#include "Entities.h"
+#include "World.h"
+#include "Physics.h"
+#include <cfloat>
+#include <chrono>
+
+constexpr int BUCKET_COUNT = World::WORLD_SIZE * World::WORLD_SIZE * World::WORLD_SIZE;
+
+template<typename T>
+static void SwapRemove(std::vector<T>& values, uint32_t index) {
+	values[index] = values.back();
+	values.pop_back();
+}
+
+EntityId EntityStore::Spawn(const Vector3& feet, const Vector3& velocity, BlockId blockId, float entityHalfWidth, float entityHeight) {
+	EntityId id;
+	if (!freeIds.empty()) {
+		id = freeIds.back();
+		freeIds.pop_back();
+	} else {
+		id = (EntityId)denseOf.size();
+		denseOf.push_back(INVALID_ENTITY);
+	}
+	denseOf[id] = (uint32_t)ids.size();
+
+	posX.push_back(feet.x); posY.push_back(feet.y); posZ.push_back(feet.z);
+	velX.push_back(velocity.x); velY.push_back(velocity.y); velZ.push_back(velocity.z);
+	halfWidth.push_back(entityHalfWidth);
+	height.push_back(entityHeight);
+	block.push_back(blockId);
+	flags.push_back(0);
+	bucket.push_back(GetBucketIndex(feet.x, feet.y, feet.z));
+	ids.push_back(id);
+	index.Insert(id, feet, std::max(entityHalfWidth, entityHeight));
+	bucketsDirty = true;
+	return id;
+}
+
+void EntityStore::Remove(EntityId id) {
+	if (!IsAlive(id)) return;
+	uint32_t i = denseOf[id];
+
+	SwapRemove(posX, i); SwapRemove(posY, i); SwapRemove(posZ, i);
+	SwapRemove(velX, i); SwapRemove(velY, i); SwapRemove(velZ, i);
+	SwapRemove(halfWidth, i);
+	SwapRemove(height, i);
+	SwapRemove(block, i);
+	SwapRemove(flags, i);
+	SwapRemove(bucket, i);
+	SwapRemove(ids, i);
+	if (i < ids.size())
+		denseOf[ids[i]] = i;
+
+	denseOf[id] = INVALID_ENTITY;
+	freeIds.push_back(id);
+	index.Remove(id);
+	bucketsDirty = true;
+}
+
+void EntityStore::Clear() {
+	posX.clear(); posY.clear(); posZ.clear();
+	velX.clear(); velY.clear(); velZ.clear();
+	halfWidth.clear();
+	height.clear();
+	block.clear();
+	flags.clear();
+	bucket.clear();
+	ids.clear();
+	denseOf.clear();
+	freeIds.clear();
+	index.Clear();
+	bucketsDirty = true;
+	stats = Stats();
+}
+
+void EntityStore::Reserve(size_t count) {
+	posX.reserve(count); posY.reserve(count); posZ.reserve(count);
+	velX.reserve(count); velY.reserve(count); velZ.reserve(count);
+	halfWidth.reserve(count);
+	height.reserve(count);
+	block.reserve(count);
+	flags.reserve(count);
+	bucket.reserve(count);
+	ids.reserve(count);
+	denseOf.reserve(count);
+}
+
+void EntityStore::Update(World& world, float dt) {
+	auto start = std::chrono::steady_clock::now();
+
+	Integrate(dt);
+	Collide(world, dt);
+	RemoveFallen();
+	UpdateBuckets();
+
+	stats.count = (int)ids.size();
+	stats.updateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void EntityStore::GetBucket(int chunkIndex, uint32_t& begin, uint32_t& end) {
+	if (bucketsDirty) SortBuckets();
+	begin = bucketStart[chunkIndex];
+	end = bucketStart[chunkIndex + 1];
+}
+
+// pure array math, no branches left once the ternary becomes a blend: the compiler vectorizes it
+void EntityStore::Integrate(float dt) {
+	const size_t count = ids.size();
+	float* vx = velX.data();
+	float* vy = velY.data();
+	float* vz = velZ.data();
+	const uint8_t* f = flags.data();
+
+	const float fall = gravity * dt;
+	const float drag = std::max(0.0f, 1.0f - airDrag * dt);
+	for (size_t i = 0; i < count; i++) {
+		float awake = (f[i] & EF_SLEEPING) ? 0.0f : 1.0f;
+		vy[i] -= fall * awake;
+		vx[i] *= drag;
+		vz[i] *= drag;
+	}
+}
+
+void EntityStore::Collide(World& world, float dt) {
+	const size_t count = ids.size();
+	const float friction = std::max(0.0f, 1.0f - groundFriction * dt);
+	stats.awake = 0;
+
+	// buckets are sorted by chunk, so consecutive entities query the same voxels
+	for (size_t i = 0; i < count; i++) {
+		if (flags[i] & EF_SLEEPING) {
+			if (HasSupport(world, posX[i], posY[i], posZ[i], halfWidth[i])) continue;
+			flags[i] &= ~EF_SLEEPING;
+		}
+		stats.awake++;
+
+		AABB box = AABB::FromFeet(Vector3(posX[i], posY[i], posZ[i]), halfWidth[i], height[i]);
+		Vector3 delta = Vector3(velX[i], velY[i], velZ[i]) * dt;
+		if (IsInEmptyChunk(world, box, delta)) {
+			// free fall in the air, the common case for anything not resting
+			posX[i] += delta.x;
+			posY[i] += delta.y;
+			posZ[i] += delta.z;
+			flags[i] &= ~EF_ON_GROUND;
+			continue;
+		}
+		CollisionResult collision = MoveAndCollide(world, box, delta);
+		posX[i] += collision.moved.x;
+		posY[i] += collision.moved.y;
+		posZ[i] += collision.moved.z;
+		if (collision.hitX) velX[i] = 0;
+		if (collision.hitY) velY[i] = 0;
+		if (collision.hitZ) velZ[i] = 0;
+
+		if (collision.onGround) {
+			flags[i] |= EF_ON_GROUND;
+			velX[i] *= friction;
+			velZ[i] *= friction;
+			if (velX[i] * velX[i] + velZ[i] * velZ[i] < 1e-4f) {
+				velX[i] = velZ[i] = 0;
+				flags[i] |= EF_SLEEPING;
+			}
+		} else {
+			flags[i] &= ~EF_ON_GROUND;
+		}
+	}
+}
+
+int EntityStore::QueryAABB(const AABB& box, EntityId* out, int capacity) {
+	return index.Query(box, out, capacity, [&](EntityId id) {
+		AABB entity = GetBox(denseOf[id]);
+		return entity.max.x >= box.min.x && entity.min.x <= box.max.x
+			&& entity.max.y >= box.min.y && entity.min.y <= box.max.y
+			&& entity.max.z >= box.min.z && entity.min.z <= box.max.z;
+	});
+}
+
+int EntityStore::QueryRadius(const Vector3& center, float radius, EntityId* out, int capacity) {
+	AABB bounds = { center - Vector3(radius), center + Vector3(radius) };
+	return index.Query(bounds, out, capacity, [&](EntityId id) {
+		// distance from the center to the closest point of the box
+		AABB entity = GetBox(denseOf[id]);
+		Vector3 closest = Vector3::Max(entity.min, Vector3::Min(center, entity.max));
+		return Vector3::DistanceSquared(center, closest) <= radius * radius;
+	});
+}
+
+bool EntityStore::Raycast(const Vector3& origin, const Vector3& dir, float maxDistance, SpatialIndex::RayHit& hit) {
+	// 1 / 0 would give 0 * inf = NaN in the slab test for an origin on the plane of a box face
+	const Vector3 invDir(
+		dir.x != 0 ? 1.0f / dir.x : FLT_MAX,
+		dir.y != 0 ? 1.0f / dir.y : FLT_MAX,
+		dir.z != 0 ? 1.0f / dir.z : FLT_MAX);
+	return index.Raycast(origin, dir, maxDistance, hit, [&](EntityId id, float maxDistance, float& distance) {
+		return IntersectRay(GetBox(denseOf[id]), origin, invDir, maxDistance, distance);
+	});
+}
+
+void EntityStore::SetPosition(EntityId id, const Vector3& feet) {
+	uint32_t i = denseOf[id];
+	posX[i] = feet.x; posY[i] = feet.y; posZ[i] = feet.z;
+	flags[i] &= ~EF_SLEEPING; // whatever it rested on is elsewhere
+	int b = GetBucketIndex(feet.x, feet.y, feet.z);
+	if (b == bucket[i]) return;
+	index.Move(id, feet);
+	bucket[i] = b;
+	bucketsDirty = true;
+}
+
+void EntityStore::RemoveFallen() {
+	stats.removed = 0;
+	for (size_t i = ids.size(); i-- > 0;) {
+		if (posY[i] < -Chunk::CHUNK_SIZE) {
+			Remove(ids[i]);
+			stats.removed++;
+		}
+	}
+}
+
+// the sort only keeps the memory order close to the chunk order, so it can lag a few ticks behind
+void EntityStore::UpdateBuckets() {
+	const size_t count = ids.size();
+	stats.moved = 0;
+	for (size_t i = 0; i < count; i++) {
+		int b = GetBucketIndex(posX[i], posY[i], posZ[i]);
+		if (b == bucket[i]) continue;
+		// same cells as the index: it only needs to hear about the entities that changed chunk
+		index.Move(ids[i], Vector3(posX[i], posY[i], posZ[i]));
+		bucket[i] = b;
+		stats.moved++;
+	}
+	if (stats.moved) bucketsDirty = true;
+
+	if (bucketsDirty && ++ticksSinceSort >= sortInterval)
+		SortBuckets();
+}
+
+// counting sort of the dense arrays by chunk
+void EntityStore::SortBuckets() {
+	const size_t count = ids.size();
+	bucketStart.assign(BUCKET_COUNT + 1, 0);
+	for (size_t i = 0; i < count; i++)
+		bucketStart[bucket[i] + 1]++;
+	for (int b = 0; b < BUCKET_COUNT; b++)
+		bucketStart[b + 1] += bucketStart[b];
+
+	// bucketStart[b] is used as the write cursor of b, so it ends up on the start of b + 1
+	order.resize(count);
+	for (size_t i = 0; i < count; i++)
+		order[bucketStart[bucket[i]]++] = (uint32_t)i;
+	for (int b = BUCKET_COUNT; b > 0; b--)
+		bucketStart[b] = bucketStart[b - 1];
+	bucketStart[0] = 0;
+
+	Permute(posX); Permute(posY); Permute(posZ);
+	Permute(velX); Permute(velY); Permute(velZ);
+	Permute(halfWidth);
+	Permute(height);
+	Permute(block);
+	Permute(flags);
+	Permute(bucket);
+	Permute(ids);
+	for (size_t i = 0; i < count; i++)
+		denseOf[ids[i]] = (uint32_t)i;
+
+	bucketsDirty = false;
+	ticksSinceSort = 0;
+}
+
+template<typename T>
+void EntityStore::Permute(std::vector<T>& values) {
+	// one typed scratch per column type, its buffer swaps with the column so nothing is reallocated after the first sort
+	static thread_local std::vector<T> sorted;
+	sorted.resize(values.size());
+	for (size_t i = 0; i < values.size(); i++)
+		sorted[i] = std::move(values[order[i]]);
+	values.swap(sorted);
+}
+
+// the swept box stays in a single chunk with nothing to collide with
+bool EntityStore::IsInEmptyChunk(World& world, const AABB& box, const Vector3& delta) {
+	Vector3 sweptMin = Vector3::Min(box.min, box.min + delta);
+	Vector3 sweptMax = Vector3::Max(box.max, box.max + delta);
+	if (sweptMin.x < 0 || sweptMin.y < 0 || sweptMin.z < 0) return false;
+	int bucket = GetBucketIndex(sweptMin.x, sweptMin.y, sweptMin.z);
+	if (bucket != GetBucketIndex(sweptMax.x, sweptMax.y, sweptMax.z)) return false;
+	return !world.GetChunkByIndex(bucket).HasCollision();
+}
+
+// is there still something right under the feet
+bool EntityStore::HasSupport(World& world, float x, float y, float z, float halfWidth) {
+	const float PROBE = 0.01f;
+	int by = (int)floor(y - PROBE);
+	for (int bz = (int)floor(z - halfWidth); bz <= (int)floor(z + halfWidth - PROBE); bz++) {
+		for (int bx = (int)floor(x - halfWidth); bx <= (int)floor(x + halfWidth - PROBE); bx++) {
+			const BlockId* cube = world.ReadCube(bx, by, bz);
+			AABB shape;
+			if (cube && GetBlockShape(*cube, shape) && by + shape.max.y >= y - PROBE)
+				return true;
+		}
+	}
+	return false;
+}
+
+int EntityStore::GetBucketIndex(float x, float y, float z) {
+	return SpatialIndex::GetCellIndex(Vector3(x, y, z));
+}
+
+void EntityStore::ShowImGui() {
+	ImGui::Begin("Entities");
+
+	ImGui::Text("%d entities, %d awake", stats.count, stats.awake);
+	ImGui::Text("%d changed chunk, %d fell out", stats.moved, stats.removed);
+	ImGui::Text("Update %.3f ms", stats.updateMs);
+	ImGui::SliderFloat("Gravity", &gravity, 0.0f, 60.0f);
+	ImGui::SliderFloat("Air drag", &airDrag, 0.0f, 4.0f);
+	ImGui::SliderFloat("Ground friction", &groundFriction, 0.0f, 30.0f);
+	ImGui::SliderInt("Sort interval", &sortInterval, 1, 60);
+	if (ImGui::Button("Clear"))
+		Clear();
+
+	ImGui::End();
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Block.h"
+#include "Physics.h"
+#include "SpatialIndex.h"
+#include <vector>
+
+using namespace DirectX::SimpleMath;
+class World;
+
+constexpr EntityId INVALID_ENTITY = ~0u;
+
+// Dropped blocks, falling sand, mobs... stored as a structure of arrays so each system is a tight loop
+// over contiguous floats. The dense arrays are kept sorted by chunk (chunk-local buckets): entities of the
+// same chunk sit next to each other, so the collision pass hits the same voxels in a row and any system
+// can walk one chunk's entities as a plain [begin, end) range.
+// Ids are stable, dense slots are not: they move on every rebucketing and removal.
+class EntityStore {
+public:
+	enum Flags : uint8_t {
+		EF_ON_GROUND = 1 << 0,
+		EF_SLEEPING = 1 << 1, // resting, skipped by the physics until the block under it goes away
+	};
+	struct Stats {
+		int count = 0;
+		int awake = 0;
+		int moved = 0; // changed chunk during the last update
+		int removed = 0; // fell out of the world during the last update
+		double updateMs = 0;
+	};
+private:
+	// dense components
+	std::vector<float> posX, posY, posZ; // feet
+	std::vector<float> velX, velY, velZ; // blocks / s
+	std::vector<float> halfWidth, height;
+	std::vector<BlockId> block;
+	std::vector<uint8_t> flags;
+	std::vector<int> bucket; // chunk index of the feet, clamped in the world
+	std::vector<EntityId> ids; // dense -> id
+
+	std::vector<uint32_t> denseOf; // id -> dense, INVALID_ENTITY when the id is free
+	std::vector<EntityId> freeIds;
+	SpatialIndex index; // broadphase on the feet, kept in sync by Spawn / Remove and the rebucketing
+
+	std::vector<uint32_t> bucketStart; // chunk count + 1 prefix sums, valid when !bucketsDirty
+	bool bucketsDirty = true;
+	int sortInterval = 8; // ticks between two sorts, GetBucket sorts on demand in between
+	int ticksSinceSort = 0;
+	std::vector<uint32_t> order; // scratch for the rebucketing
+
+	float gravity = 30.0f;
+	float airDrag = 0.5f; // fraction of the horizontal speed lost per second
+	float groundFriction = 8.0f;
+	Stats stats;
+public:
+	EntityStore() = default;
+
+	EntityId Spawn(const Vector3& feet, const Vector3& velocity, BlockId block, float halfWidth = 0.25f, float height = 0.5f);
+	void Remove(EntityId id);
+	// teleport: the index follows right away, the dense order at the next sort
+	void SetPosition(EntityId id, const Vector3& feet);
+	void Clear();
+	void Reserve(size_t count);
+
+	bool IsAlive(EntityId id) const { return id < denseOf.size() && denseOf[id] != INVALID_ENTITY; }
+	Vector3 GetPosition(EntityId id) const { uint32_t i = denseOf[id]; return Vector3(posX[i], posY[i], posZ[i]); }
+	Vector3 GetVelocity(EntityId id) const { uint32_t i = denseOf[id]; return Vector3(velX[i], velY[i], velZ[i]); }
+	BlockId GetBlock(EntityId id) const { return block[denseOf[id]]; }
+	uint8_t GetFlags(EntityId id) const { return flags[denseOf[id]]; }
+	int GetCount() const { return (int)ids.size(); }
+	SpatialIndex& GetIndex() { return index; }
+
+	// broadphase through the index then exact test on the entity boxes, at most capacity ids are written
+	int QueryAABB(const AABB& box, EntityId* out, int capacity);
+	int QueryRadius(const Vector3& center, float radius, EntityId* out, int capacity);
+	bool Raycast(const Vector3& origin, const Vector3& dir, float maxDistance, SpatialIndex::RayHit& hit);
+
+	// one simulation tick: gravity and drag, collision against the voxels, then rebucketing every sortInterval ticks
+	void Update(World& world, float dt);
+	// dense range of the entities whose feet are in the chunk, valid until the next Spawn / Remove / Update
+	void GetBucket(int chunkIndex, uint32_t& begin, uint32_t& end);
+
+	const Stats& GetStats() const { return stats; }
+	void ShowImGui();
+private:
+	AABB GetBox(uint32_t i) const { return AABB::FromFeet(Vector3(posX[i], posY[i], posZ[i]), halfWidth[i], height[i]); }
+	void Integrate(float dt);
+	void Collide(World& world, float dt);
+	void RemoveFallen();
+	void UpdateBuckets();
+	void SortBuckets();
+	template<typename T> void Permute(std::vector<T>& values);
+	static bool IsInEmptyChunk(World& world, const AABB& box, const Vector3& delta);
+	static bool HasSupport(World& world, float x, float y, float z, float halfWidth);
+	static int GetBucketIndex(float x, float y, float z);
+};
@@ -0,0 +1,152 @@
+#include "pch.h"
+
+#include "Explosions.h"
+#include "World.h"
+#include <chrono>
+
+constexpr int SPHERE_RESOLUTION = 16; // rays through the surface of a 16^3 grid: 1352, 169 packets
+constexpr float RAY_STEP = 0.3f;
+constexpr float STEP_ATTENUATION = 0.225f;
+
+Explosions::Explosions() : rng(4242) {
+	for (int k = 0; k < SPHERE_RESOLUTION; k++) {
+		for (int j = 0; j < SPHERE_RESOLUTION; j++) {
+			for (int i = 0; i < SPHERE_RESOLUTION; i++) {
+				auto onSurface = [](int v) { return v == 0 || v == SPHERE_RESOLUTION - 1; };
+				if (!onSurface(i) && !onSurface(j) && !onSurface(k)) continue;
+				Vector3 dir(i, j, k);
+				dir = dir / (SPHERE_RESOLUTION - 1) * 2.0f - Vector3::One;
+				dir.Normalize();
+				dirX.push_back(dir.x);
+				dirY.push_back(dir.y);
+				dirZ.push_back(dir.z);
+			}
+		}
+	}
+	// pad the last packet with dead lanes
+	while (dirX.size() % PACKET_SIZE) {
+		dirX.push_back(0);
+		dirY.push_back(0);
+		dirZ.push_back(0);
+	}
+}
+
+void Explosions::Ignite(World& world, int gx, int gy, int gz) {
+	const BlockId* cube = world.ReadCube(gx, gy, gz);
+	if (!cube || *cube != TNT) return;
+	world.SetCube(gx, gy, gz, EMPTY);
+	Detonate(Vector3(gx + 0.5f, gy + 0.5f, gz + 0.5f), power, fuse);
+}
+
+void Explosions::Detonate(const Vector3& center, float explosionPower, int delay) {
+	pending.push_back({ center, explosionPower, tick + std::max(delay, 1) });
+}
+
+void Explosions::Tick(World& world) {
+	tick++;
+	detonating.clear();
+	for (size_t i = 0; i < pending.size();) {
+		if (pending[i].due <= tick) {
+			detonating.push_back(pending[i]);
+			pending[i] = pending.back();
+			pending.pop_back();
+		} else {
+			i++;
+		}
+	}
+	if (detonating.empty()) return;
+
+	auto start = std::chrono::steady_clock::now();
+	stats.rays = 0;
+	destroyed.clear();
+	for (auto& explosion : detonating) {
+		for (size_t first = 0; first < dirX.size(); first += PACKET_SIZE)
+			CastPacket(world, explosion.center, explosion.power, first);
+		stats.rays += (int)dirX.size();
+	}
+	stats.detonated = (int)detonating.size();
+	stats.totalDetonated += stats.detonated;
+
+	std::sort(destroyed.begin(), destroyed.end());
+	destroyed.erase(std::unique(destroyed.begin(), destroyed.end()), destroyed.end());
+	std::uniform_int_distribution<int> chainFuse(chainFuseMin, std::max(chainFuseMin, chainFuseMax));
+	batch.clear();
+	for (uint32_t key : destroyed) {
+		int gx, gy, gz;
+		UnpackCell(key, gx, gy, gz);
+		if (*world.ReadCube(gx, gy, gz) == TNT)
+			Detonate(Vector3(gx + 0.5f, gy + 0.5f, gz + 0.5f), power, chainFuse(rng));
+		batch.push_back({ gx, gy, gz, EMPTY });
+	}
+	stats.removed = (int)batch.size();
+	stats.totalRemoved += stats.removed;
+	stats.dirtyChunks = world.ApplyEdits(batch);
+	stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Explosions::Clear() {
+	pending.clear();
+	stats = Stats();
+}
+
+// Rays march by RAY_STEP, each block crossed costs (resistance + 0.3) * RAY_STEP and every step costs
+// STEP_ATTENUATION, a block is destroyed when the ray still has power after paying for it.
+// The 8 lanes advance in lockstep: positions are updated as one SoA loop, only the voxel fetches are scalar.
+void Explosions::CastPacket(World& world, const Vector3& center, float explosionPower, size_t first) {
+	float px[PACKET_SIZE], py[PACKET_SIZE], pz[PACKET_SIZE];
+	float dx[PACKET_SIZE], dy[PACKET_SIZE], dz[PACKET_SIZE];
+	float intensity[PACKET_SIZE];
+	std::uniform_real_distribution<float> spread(0.7f, 1.3f);
+	for (int lane = 0; lane < PACKET_SIZE; lane++) {
+		px[lane] = center.x;
+		py[lane] = center.y;
+		pz[lane] = center.z;
+		dx[lane] = dirX[first + lane] * RAY_STEP;
+		dy[lane] = dirY[first + lane] * RAY_STEP;
+		dz[lane] = dirZ[first + lane] * RAY_STEP;
+		bool padding = dx[lane] == 0 && dy[lane] == 0 && dz[lane] == 0;
+		intensity[lane] = padding ? 0.0f : explosionPower * spread(rng);
+	}
+
+	for (;;) {
+		for (int lane = 0; lane < PACKET_SIZE; lane++) {
+			px[lane] += dx[lane];
+			py[lane] += dy[lane];
+			pz[lane] += dz[lane];
+		}
+
+		bool alive = false;
+		for (int lane = 0; lane < PACKET_SIZE; lane++) {
+			if (intensity[lane] <= 0) continue;
+			int gx = (int)floorf(px[lane]);
+			int gy = (int)floorf(py[lane]);
+			int gz = (int)floorf(pz[lane]);
+			const BlockId* cube = world.ReadCube(gx, gy, gz);
+			if (!cube) {
+				intensity[lane] = 0; // left the world
+				continue;
+			}
+			if (*cube != EMPTY) {
+				intensity[lane] -= (BlockData::Get(*cube).resistance + 0.3f) * RAY_STEP;
+				if (intensity[lane] > 0) destroyed.push_back(PackCell(gx, gy, gz));
+			}
+			intensity[lane] -= STEP_ATTENUATION;
+			alive |= intensity[lane] > 0;
+		}
+		if (!alive) break;
+	}
+}
+
+void Explosions::ShowImGui() {
+	ImGui::Begin("Explosions");
+
+	ImGui::SliderFloat("Power", &power, 0.5f, 16.0f);
+	ImGui::SliderInt("Fuse", &fuse, 1, 200);
+	ImGui::SliderInt("Chain fuse min", &chainFuseMin, 1, 100);
+	ImGui::SliderInt("Chain fuse max", &chainFuseMax, 1, 100);
+	ImGui::Text("%d pending, %d detonated, %d removed", (int)pending.size(), stats.totalDetonated, stats.totalRemoved);
+	ImGui::Text("Last: %d detonated, %d rays, %d removed, %d dirty chunks, %.3f ms",
+		stats.detonated, stats.rays, stats.removed, stats.dirtyChunks, stats.ms);
+
+	ImGui::End();
+}
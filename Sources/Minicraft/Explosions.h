@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Block.h"
+#include <random>
+#include <vector>
+
+using namespace DirectX::SimpleMath;
+class World;
+
+// TNT: every explosion casts the same sphere of rays that lose power through the blocks they cross
+// (BlockData::resistance). Rays go by packets of 8, the lanes step together over SoA arrays.
+// Everything detonating on a tick reads the same world and its removals go through one World::ApplyEdits,
+// so a chain of explosions dirties each chunk once per tick. TNT caught in a blast is queued with a short fuse.
+class Explosions {
+public:
+	constexpr static int PACKET_SIZE = 8;
+	struct Stats {
+		int detonated = 0; // on the last tick that had explosions
+		int rays = 0;
+		int removed = 0;
+		int dirtyChunks = 0;
+		double ms = 0;
+		int totalDetonated = 0; // since the last Clear
+		int totalRemoved = 0;
+	};
+private:
+	struct Pending {
+		Vector3 center;
+		float power;
+		uint64_t due;
+	};
+	std::vector<Pending> pending;
+	std::vector<Pending> detonating;
+	std::vector<float> dirX, dirY, dirZ; // the ray sphere, a multiple of PACKET_SIZE
+	std::vector<uint32_t> destroyed; // cells, with duplicates until the end of the tick
+	std::vector<BlockEdit> batch;
+	std::mt19937 rng;
+	uint64_t tick = 0;
+
+	float power = 4.0f;
+	int fuse = 80; // ignited by the player
+	int chainFuseMin = 10, chainFuseMax = 30; // lit by another explosion
+	Stats stats;
+public:
+	Explosions();
+
+	// replaces the TNT by nothing and detonates it after the fuse
+	void Ignite(World& world, int gx, int gy, int gz);
+	void Detonate(const Vector3& center, float power, int delay);
+	void Tick(World& world);
+	void Clear();
+
+	int GetPendingCount() const { return (int)pending.size(); }
+	const Stats& GetStats() const { return stats; }
+	void ShowImGui();
+private:
+	void CastPacket(World& world, const Vector3& center, float power, size_t first);
+};
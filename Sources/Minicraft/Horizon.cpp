@@ -0,0 +1,196 @@
+#include "pch.h"
+
+#include "Horizon.h"
+#include <chrono>
+
+static int PositiveMod(int a, int b) { return ((a % b) + b) % b; }
+
+void Horizon::Reset(const WorldGenParams& params, int worldBlocks) {
+	generator = std::make_unique<WorldGenerator>(params);
+	waterTop = (int)ceilf(params.waterHeight);
+	for (auto& levelSamples : samples)
+		levelSamples.assign(SAMPLES * SAMPLES, Sample());
+	holeMin = 0;
+	holeMax = worldBlocks;
+	meshDirty = true;
+	stats = Stats();
+}
+
+int Horizon::Update(const Vector3& cameraPos) {
+	if (!generator) return 0;
+	auto start = std::chrono::steady_clock::now();
+	int sampled = 0;
+	for (int level = 0; level < LEVEL_COUNT; level++) {
+		const int cellSize = GetCellSize(level);
+		// snapped to two cells: the level lines up on the cells of the next one
+		int ox = (int)floorf(cameraPos.x / (2 * cellSize)) * 2 - GRID / 2;
+		int oz = (int)floorf(cameraPos.z / (2 * cellSize)) * 2 - GRID / 2;
+		if (ox != originX[level] || oz != originZ[level]) meshDirty = true;
+		originX[level] = ox;
+		originZ[level] = oz;
+
+		for (int j = 0; j < SAMPLES; j++) {
+			for (int i = 0; i < SAMPLES; i++) {
+				Sample& sample = GetSlot(level, ox + i, oz + j);
+				if (sample.keyX == ox + i && sample.keyZ == oz + j) continue;
+				sample.keyX = ox + i;
+				sample.keyZ = oz + j;
+				SampleColumn(sample.keyX * cellSize, sample.keyZ * cellSize, sample.height, sample.top);
+				sampled++;
+			}
+		}
+	}
+	stats.sampled = sampled;
+	stats.totalSampled += sampled;
+	stats.updateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return sampled;
+}
+
+void Horizon::BuildMesh() {
+	vBuffer.Clear();
+	iBuffer.Clear();
+	stats.quads = 0;
+	const Vector3 sun = Vector3(1, 2, 1) / sqrtf(6.0f);
+	float heights[SAMPLES][SAMPLES];
+
+	for (int level = 0; level < LEVEL_COUNT; level++) {
+		const int cellSize = GetCellSize(level);
+		const int ox = originX[level], oz = originZ[level];
+		for (int j = 0; j < SAMPLES; j++)
+			for (int i = 0; i < SAMPLES; i++)
+				heights[j][i] = GetSlot(level, ox + i, oz + j).height;
+		// the odd vertices of the outer border sit in the middle of an edge of the next level: no T-junction crack
+		if (level < LEVEL_COUNT - 1) {
+			for (int k = 1; k < GRID; k += 2) {
+				heights[0][k] = (heights[0][k - 1] + heights[0][k + 1]) * 0.5f;
+				heights[GRID][k] = (heights[GRID][k - 1] + heights[GRID][k + 1]) * 0.5f;
+				heights[k][0] = (heights[k - 1][0] + heights[k + 1][0]) * 0.5f;
+				heights[k][GRID] = (heights[k - 1][GRID] + heights[k + 1][GRID]) * 0.5f;
+			}
+		}
+
+		uint32_t first = 0;
+		for (int j = 0; j < SAMPLES; j++) {
+			for (int i = 0; i < SAMPLES; i++) {
+				// slope shading from the neighbour heights
+				float dx = heights[j][std::min(i + 1, GRID)] - heights[j][std::max(i - 1, 0)];
+				float dz = heights[std::min(j + 1, GRID)][i] - heights[std::max(j - 1, 0)][i];
+				Vector3 normal(-dx, 2.0f * cellSize, -dz);
+				normal.Normalize();
+				float shade = 0.6f + 0.4f * std::max(0.0f, normal.Dot(sun));
+				Vector3 color = GetColor(GetSlot(level, ox + i, oz + j).top) * shade;
+				Vector3 pos((float)((ox + i) * cellSize), heights[j][i], (float)((oz + j) * cellSize));
+				uint32_t index = vBuffer.PushVertex(VertexLayout_PositionColor(pos, Vector4(color.x, color.y, color.z, 1.0f)));
+				if (i == 0 && j == 0) first = index;
+			}
+		}
+
+		// the finer level inside, and the voxel world (wherever the levels are)
+		const int innerSize = level > 0 ? GetCellSize(level - 1) : 0;
+		const int innerMinX = level > 0 ? originX[level - 1] * innerSize : 0, innerMaxX = innerMinX + GRID * innerSize;
+		const int innerMinZ = level > 0 ? originZ[level - 1] * innerSize : 0, innerMaxZ = innerMinZ + GRID * innerSize;
+		for (int j = 0; j < GRID; j++) {
+			for (int i = 0; i < GRID; i++) {
+				int x0 = (ox + i) * cellSize, z0 = (oz + j) * cellSize;
+				int x1 = x0 + cellSize, z1 = z0 + cellSize;
+				if (x1 > holeMin && x0 < holeMax && z1 > holeMin && z0 < holeMax) continue;
+				if (level > 0 && x0 >= innerMinX && x1 <= innerMaxX && z0 >= innerMinZ && z1 <= innerMaxZ) continue;
+				uint32_t a = first + i + j * SAMPLES;
+				uint32_t b = a + 1, c = a + SAMPLES, d = c + 1;
+				iBuffer.PushTriangle(a, c, d);
+				iBuffer.PushTriangle(a, d, b);
+				stats.quads++;
+			}
+		}
+	}
+	meshDirty = false;
+	bufferDirty = true;
+}
+
+void Horizon::Draw(DeviceResources* deviceRes) {
+	if (!enabled || !generator) return;
+	if (meshDirty) BuildMesh();
+	if (bufferDirty) {
+		vBuffer.Create(deviceRes);
+		iBuffer.Create(deviceRes);
+		bufferDirty = false;
+	}
+	if (iBuffer.Size() == 0) return;
+	vBuffer.Apply(deviceRes);
+	iBuffer.Apply(deviceRes);
+	deviceRes->GetD3DDeviceContext()->DrawIndexed(iBuffer.Size(), 0, 0);
+}
+
+bool Horizon::GetSample(int level, int gx, int gz, float& height, BlockId& top) const {
+	const int cellSize = GetCellSize(level);
+	if (gx % cellSize || gz % cellSize) return false;
+	int keyX = gx / cellSize, keyZ = gz / cellSize;
+	const Sample& sample = samples[level][PositiveMod(keyX, SAMPLES) + PositiveMod(keyZ, SAMPLES) * SAMPLES];
+	if (sample.keyX != keyX || sample.keyZ != keyZ) return false;
+	height = sample.height;
+	top = sample.top;
+	return true;
+}
+
+int Horizon::Verify() const {
+	if (!generator) return 0;
+	int mismatches = 0;
+	for (int level = 0; level < LEVEL_COUNT; level++) {
+		const int cellSize = GetCellSize(level);
+		for (int j = 0; j < SAMPLES; j++) {
+			for (int i = 0; i < SAMPLES; i++) {
+				int gx = (originX[level] + i) * cellSize, gz = (originZ[level] + j) * cellSize;
+				float height, expectedHeight;
+				BlockId top, expectedTop;
+				SampleColumn(gx, gz, expectedHeight, expectedTop);
+				if (!GetSample(level, gx, gz, height, top) || height != expectedHeight || top != expectedTop)
+					mismatches++;
+			}
+		}
+	}
+	return mismatches;
+}
+
+size_t Horizon::GetMemory() const {
+	size_t sampleBytes = LEVEL_COUNT * SAMPLES * SAMPLES * sizeof(Sample);
+	size_t meshBytes = LEVEL_COUNT * SAMPLES * SAMPLES * sizeof(VertexLayout_PositionColor) + stats.quads * 6 * sizeof(uint32_t);
+	return sampleBytes + meshBytes;
+}
+
+void Horizon::ShowImGui() {
+	ImGui::Begin("Horizon");
+
+	ImGui::Checkbox("Enabled", &enabled);
+	ImGui::Text("%d levels of %dx%d quads, %d blocks to the edge", LEVEL_COUNT, GRID, GRID, GRID / 2 * GetCellSize(LEVEL_COUNT - 1));
+	ImGui::Text("%d quads drawn, %.1f KB", stats.quads, GetMemory() / 1024.0);
+	ImGui::Text("Last update: %d columns sampled, %.3f ms (%d since reset)", stats.sampled, stats.updateMs, stats.totalSampled);
+
+	ImGui::End();
+}
+
+Horizon::Sample& Horizon::GetSlot(int level, int keyX, int keyZ) {
+	return samples[level][PositiveMod(keyX, SAMPLES) + PositiveMod(keyZ, SAMPLES) * SAMPLES];
+}
+
+// top of the column as World::Generate would build it: the last dirt / grass block, or the water over it
+void Horizon::SampleColumn(int gx, int gz, float& height, BlockId& top) const {
+	WorldGenerator::Column column = generator->GetColumn(gx, gz);
+	int landTop = column.yDirt + 1;
+	if (waterTop > landTop) {
+		height = (float)waterTop;
+		top = WATER;
+	} else {
+		height = (float)landTop;
+		top = generator->GetBlock(column, column.yDirt);
+	}
+}
+
+Vector3 Horizon::GetColor(BlockId top) {
+	switch (top) {
+	case GRASS: return Vector3(0.36f, 0.58f, 0.24f);
+	case DIRT: return Vector3(0.52f, 0.37f, 0.24f);
+	case WATER: return Vector3(0.18f, 0.33f, 0.72f);
+	case SAND: return Vector3(0.86f, 0.81f, 0.6f);
+	default: return Vector3(0.5f, 0.5f, 0.5f);
+	}
+}
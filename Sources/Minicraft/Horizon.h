@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Engine/Buffer.h"
+#include "Engine/VertexLayout.h"
+#include "WorldGenerator.h"
+#include <climits>
+#include <memory>
+#include <vector>
+
+// Terrain past the voxel world, straight from the generator's height function: nothing is voxelized.
+// Clipmap of LEVEL_COUNT nested square grids of GRID quads, each level twice as coarse as the previous one and
+// skipping the area of the finer level inside it (level 0 skips the voxel world). Vertices are colored by the
+// top block of their column. The samples live in a toroidal array per level: when the camera moves only the
+// rows and columns entering a level are sampled, the mesh is rebuilt from the stored samples.
+class Horizon {
+public:
+	constexpr static int LEVEL_COUNT = 4;
+	constexpr static int GRID = 32; // quads per side of a level
+	constexpr static int BASE_CELL = 4; // blocks per quad on level 0
+	struct Stats {
+		int sampled = 0; // by the last Update
+		int totalSampled = 0; // since the last Reset
+		int quads = 0;
+		double updateMs = 0;
+	};
+private:
+	constexpr static int SAMPLES = GRID + 1; // per side of a level
+
+	struct Sample {
+		int keyX = INT_MIN, keyZ = INT_MIN; // vertex coordinates in cells of the level, the slot is key mod SAMPLES
+		float height = 0;
+		BlockId top = EMPTY;
+	};
+	std::unique_ptr<WorldGenerator> generator;
+	int waterTop = 0;
+	std::vector<Sample> samples[LEVEL_COUNT];
+	int originX[LEVEL_COUNT] = {}, originZ[LEVEL_COUNT] = {}; // first vertex of each level, in cells of the level
+	int holeMin = 0, holeMax = 0; // the voxel world on x and z, in blocks
+	bool meshDirty = true;
+	bool bufferDirty = true;
+	bool enabled = true;
+
+	VertexBuffer<VertexLayout_PositionColor> vBuffer;
+	IndexBuffer iBuffer;
+	Stats stats;
+public:
+	// new terrain function, the voxel world covers [0, worldBlocks) on x and z
+	void Reset(const WorldGenParams& params, int worldBlocks);
+	// recenters the levels around the camera, returns the number of columns sampled
+	int Update(const Vector3& cameraPos);
+	// CPU side of Draw, no device needed
+	void BuildMesh();
+	void Draw(DeviceResources* deviceRes);
+
+	static int GetCellSize(int level) { return BASE_CELL << level; }
+	// stored sample of a vertex of a level, in blocks, false when it is not in the level
+	bool GetSample(int level, int gx, int gz, float& height, BlockId& top) const;
+	// samples that differ from the generator, 0 when the incremental updates are right
+	int Verify() const;
+	size_t GetMemory() const;
+	const Stats& GetStats() const { return stats; }
+	bool IsEnabled() const { return enabled; }
+	void ShowImGui();
+private:
+	Sample& GetSlot(int level, int keyX, int keyZ);
+	void SampleColumn(int gx, int gz, float& height, BlockId& top) const;
+	static Vector3 GetColor(BlockId top);
+};
@@ -0,0 +1,281 @@
+#include "pch.h"
+
+#include "Lighting.h"
+#include "World.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+constexpr int GLOBAL_SIZE = World::WORLD_SIZE * Chunk::CHUNK_SIZE;
+
+namespace {
+	int GetLevel(uint8_t packed, int shift) { return (packed >> shift) & Lighting::MAX_LIGHT; }
+	void SetLevel(uint8_t& packed, int shift, int level) {
+		packed = (uint8_t)((packed & ~(Lighting::MAX_LIGHT << shift)) | (level << shift));
+	}
+
+	struct Bounds {
+		int min[3];
+		int max[3]; // exclusive
+		bool Contains(int x, int y, int z) const {
+			return x >= min[0] && y >= min[1] && z >= min[2] && x < max[0] && y < max[1] && z < max[2];
+		}
+	};
+	const Bounds WORLD_BOUNDS = { { 0, 0, 0 }, { GLOBAL_SIZE, GLOBAL_SIZE, GLOBAL_SIZE } };
+
+	// sky light at full strength falls without loss through clear blocks
+	bool IsSkyFall(int shift, int face, int level, int absorption) {
+		return shift == Lighting::SKY_SHIFT && face == Chunk::FACE_NEG_Y && level == Lighting::MAX_LIGHT && absorption == 1;
+	}
+
+	int GetCellEmission(World& world, int x, int y, int z, BlockId id) {
+		if (!(BlockTables::GetFlags(id) & BF_HAS_STATE)) return Lighting::GetEmission(id, 0);
+		return Lighting::GetEmission(id, world.GetState(x, y, z));
+	}
+
+	// spreads the light of the queued cells, onChange(cell) for every value raised
+	template<typename OnChange>
+	void PropagateAdd(World& world, std::vector<uint32_t>& queue, int shift, const Bounds& bounds, OnChange&& onChange) {
+		for (size_t head = 0; head < queue.size(); head++) {
+			int x, y, z;
+			UnpackCell(queue[head], x, y, z);
+			ChunkCursor cursor = world.GetCursor(x, y, z);
+			int level = GetLevel(*cursor.GetLight(), shift);
+			if (level <= 1) continue;
+			for (int face = 0; face < Chunk::FACE_COUNT; face++) {
+				int nx = x + Chunk::FACE_DIRS[face][0];
+				int ny = y + Chunk::FACE_DIRS[face][1];
+				int nz = z + Chunk::FACE_DIRS[face][2];
+				if (!bounds.Contains(nx, ny, nz)) continue;
+				ChunkCursor next = cursor.Neighbour(face);
+				int absorption = Lighting::GetAbsorption(*next.GetCube());
+				int target = IsSkyFall(shift, face, level, absorption) ? Lighting::MAX_LIGHT : level - absorption;
+				uint8_t& light = *next.GetLight();
+				if (GetLevel(light, shift) >= target) continue;
+				SetLevel(light, shift, target);
+				uint32_t cell = PackCell(nx, ny, nz);
+				queue.push_back(cell);
+				onChange(cell);
+			}
+		}
+		queue.clear();
+	}
+
+	// Clears what the removed cells lit. A neighbour darker than the removed light (or sky light falling from it)
+	// was lit by it and is cleared in turn, a brighter one has its own source and goes to the add queue to refill the hole
+	template<typename OnChange>
+	void PropagateRemove(World& world, Lighting::Queues& queues, int shift, OnChange&& onChange) {
+		for (size_t head = 0; head < queues.remove.size(); head++) {
+			int x, y, z;
+			UnpackCell(queues.remove[head].first, x, y, z);
+			int level = queues.remove[head].second;
+			ChunkCursor cursor = world.GetCursor(x, y, z);
+			for (int face = 0; face < Chunk::FACE_COUNT; face++) {
+				ChunkCursor next = cursor.Neighbour(face);
+				if (!next.IsValid()) continue;
+				uint8_t& light = *next.GetLight();
+				int neighbourLevel = GetLevel(light, shift);
+				if (neighbourLevel == 0) continue;
+
+				int nx = x + Chunk::FACE_DIRS[face][0];
+				int ny = y + Chunk::FACE_DIRS[face][1];
+				int nz = z + Chunk::FACE_DIRS[face][2];
+				uint32_t cell = PackCell(nx, ny, nz);
+				BlockId id = *next.GetCube();
+				if (neighbourLevel < level || IsSkyFall(shift, face, level, Lighting::GetAbsorption(id))) {
+					SetLevel(light, shift, 0);
+					queues.remove.push_back({ cell, (uint8_t)neighbourLevel });
+					onChange(cell);
+					// an emitter keeps its own light
+					int emission = shift == Lighting::BLOCK_SHIFT ? GetCellEmission(world, nx, ny, nz, id) : 0;
+					if (emission > 0) {
+						SetLevel(light, shift, emission);
+						queues.add.push_back(cell);
+					}
+				} else {
+					queues.add.push_back(cell);
+				}
+			}
+		}
+		queues.remove.clear();
+	}
+
+	// first pass of ComputeAll, touches only the chunks of the column so columns run in parallel
+	void LightColumn(World& world, Lighting::Queues& queues, int cx, int cz) {
+		const int x0 = cx * Chunk::CHUNK_SIZE, z0 = cz * Chunk::CHUNK_SIZE;
+		const Bounds bounds = { { x0, 0, z0 }, { x0 + Chunk::CHUNK_SIZE, GLOBAL_SIZE, z0 + Chunk::CHUNK_SIZE } };
+		for (int z = z0; z < z0 + Chunk::CHUNK_SIZE; z++) {
+			for (int x = x0; x < x0 + Chunk::CHUNK_SIZE; x++) {
+				int sky = Lighting::MAX_LIGHT;
+				for (int y = GLOBAL_SIZE - 1; y >= 0; y--) {
+					BlockId id = *world.ReadCube(x, y, z);
+					int absorption = Lighting::GetAbsorption(id);
+					// same rule as the BFS: only full sky light falls through clear blocks without loss
+					if (absorption > 1 || sky < Lighting::MAX_LIGHT) sky = std::max(0, sky - absorption);
+					int emission = GetCellEmission(world, x, y, z, id);
+					*world.GetLight(x, y, z) = (uint8_t)(sky << Lighting::SKY_SHIFT | emission << Lighting::BLOCK_SHIFT);
+				}
+			}
+		}
+		// most of the sky is already final, only the cells brighter than a clear neighbour have to spread
+		for (int z = z0; z < z0 + Chunk::CHUNK_SIZE; z++) {
+			for (int y = 0; y < GLOBAL_SIZE; y++) {
+				for (int x = x0; x < x0 + Chunk::CHUNK_SIZE; x++) {
+					int level = GetLevel(*world.GetLight(x, y, z), Lighting::SKY_SHIFT);
+					if (level <= 1) continue;
+					for (int face = 0; face < Chunk::FACE_COUNT; face++) {
+						int nx = x + Chunk::FACE_DIRS[face][0];
+						int ny = y + Chunk::FACE_DIRS[face][1];
+						int nz = z + Chunk::FACE_DIRS[face][2];
+						if (!bounds.Contains(nx, ny, nz)) continue;
+						if (GetLevel(*world.GetLight(nx, ny, nz), Lighting::SKY_SHIFT) >= level - 1) continue;
+						if (Lighting::GetAbsorption(*world.ReadCube(nx, ny, nz)) > Lighting::MAX_LIGHT) continue;
+						queues.add.push_back(PackCell(x, y, z));
+						break;
+					}
+				}
+			}
+		}
+		PropagateAdd(world, queues.add, Lighting::SKY_SHIFT, bounds, [](uint32_t) {});
+
+		for (int z = z0; z < z0 + Chunk::CHUNK_SIZE; z++)
+			for (int y = 0; y < GLOBAL_SIZE; y++)
+				for (int x = x0; x < x0 + Chunk::CHUNK_SIZE; x++)
+					if (GetLevel(*world.GetLight(x, y, z), Lighting::BLOCK_SHIFT) > 1) queues.add.push_back(PackCell(x, y, z));
+		PropagateAdd(world, queues.add, Lighting::BLOCK_SHIFT, bounds, [](uint32_t) {});
+	}
+}
+
+int Lighting::GetAbsorption(BlockId id) {
+	if (BlockTables::IsOpaque(id)) return MAX_LIGHT + 1;
+	if (BlockTables::GetFlags(id) & BF_GRAVITY_WATER) return 2;
+	return 1;
+}
+
+int Lighting::GetEmission(BlockId id, BlockState state) {
+	if (id == FURNACE && (state & BS_LIT)) return 13;
+	return 0;
+}
+
+void Lighting::ComputeAll(World& world) {
+	auto start = std::chrono::steady_clock::now();
+	const int COLUMN_COUNT = World::WORLD_SIZE * World::WORLD_SIZE;
+
+	int threadCount = std::clamp((int)std::thread::hardware_concurrency(), 1, 16);
+	std::vector<Queues> threadQueues(threadCount);
+	std::atomic<int> nextColumn = 0;
+	auto worker = [&](Queues& workerQueues) {
+		for (int column = nextColumn++; column < COLUMN_COUNT; column = nextColumn++)
+			LightColumn(world, workerQueues, column % World::WORLD_SIZE, column / World::WORLD_SIZE);
+	};
+	std::vector<std::thread> threads;
+	for (int i = 1; i < threadCount; i++)
+		threads.emplace_back(worker, std::ref(threadQueues[i]));
+	worker(threadQueues[0]);
+	for (auto& thread : threads)
+		thread.join();
+
+	// light crossing the column borders: every border cell brighter than its neighbour across spreads again
+	for (int shift : { SKY_SHIFT, BLOCK_SHIFT }) {
+		for (int z = 0; z < GLOBAL_SIZE; z++) {
+			for (int x = 0; x < GLOBAL_SIZE; x++) {
+				int lx = Chunk::Dims::ToLocal(x), lz = Chunk::Dims::ToLocal(z);
+				int dx = lx == 0 ? -1 : (lx == Chunk::CHUNK_SIZE - 1 ? 1 : 0);
+				int dz = lz == 0 ? -1 : (lz == Chunk::CHUNK_SIZE - 1 ? 1 : 0);
+				if (dx == 0 && dz == 0) continue;
+				for (int y = 0; y < GLOBAL_SIZE; y++) {
+					int level = GetLevel(*world.GetLight(x, y, z), shift);
+					if (level <= 1) continue;
+					uint8_t* acrossX = dx ? world.GetLight(x + dx, y, z) : nullptr;
+					uint8_t* acrossZ = dz ? world.GetLight(x, y, z + dz) : nullptr;
+					bool brighter = (acrossX && GetLevel(*acrossX, shift) < level - 1) || (acrossZ && GetLevel(*acrossZ, shift) < level - 1);
+					if (brighter) queues.add.push_back(PackCell(x, y, z));
+				}
+			}
+		}
+		PropagateAdd(world, queues.add, shift, WORLD_BOUNDS, [](uint32_t) {});
+	}
+
+	stats.initialMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	stats.threads = threadCount;
+}
+
+void Lighting::Update(World& world, const BlockEdit* cells, size_t count) {
+	auto start = std::chrono::steady_clock::now();
+	int changed = 0;
+	auto onChange = [&](uint32_t cell) {
+		changed++;
+		MarkChanged(world, cell);
+	};
+
+	for (int shift : { SKY_SHIFT, BLOCK_SHIFT }) {
+		for (size_t i = 0; i < count; i++) {
+			uint8_t* light = world.GetLight(cells[i].gx, cells[i].gy, cells[i].gz);
+			if (!light) continue;
+			int level = GetLevel(*light, shift);
+			if (level == 0) continue;
+			SetLevel(*light, shift, 0);
+			queues.remove.push_back({ PackCell(cells[i].gx, cells[i].gy, cells[i].gz), (uint8_t)level });
+			onChange(queues.remove.back().first);
+		}
+		PropagateRemove(world, queues, shift, onChange);
+
+		// refill: the cell's own emission, the sky right above the world, and whatever its neighbours bring
+		for (size_t i = 0; i < count; i++) {
+			int x = cells[i].gx, y = cells[i].gy, z = cells[i].gz;
+			uint8_t* light = world.GetLight(x, y, z);
+			if (!light) continue;
+			BlockId id = *world.ReadCube(x, y, z);
+			int own = 0;
+			if (shift == BLOCK_SHIFT)
+				own = GetCellEmission(world, x, y, z, id);
+			else if (y == GLOBAL_SIZE - 1 && GetAbsorption(id) <= MAX_LIGHT)
+				own = GetAbsorption(id) > 1 ? MAX_LIGHT - GetAbsorption(id) : MAX_LIGHT;
+			if (own > GetLevel(*light, shift)) {
+				SetLevel(*light, shift, own);
+				queues.add.push_back(PackCell(x, y, z));
+				onChange(queues.add.back());
+			}
+			for (int face = 0; face < Chunk::FACE_COUNT; face++) {
+				int nx = x + Chunk::FACE_DIRS[face][0];
+				int ny = y + Chunk::FACE_DIRS[face][1];
+				int nz = z + Chunk::FACE_DIRS[face][2];
+				if (!WORLD_BOUNDS.Contains(nx, ny, nz)) continue;
+				if (GetLevel(*world.GetLight(nx, ny, nz), shift) > 1) queues.add.push_back(PackCell(nx, ny, nz));
+			}
+		}
+		PropagateAdd(world, queues.add, shift, WORLD_BOUNDS, onChange);
+	}
+
+	stats.lastCells = changed;
+	stats.lastMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	stats.maxMs = std::max(stats.maxMs, stats.lastMs);
+	stats.totalMs += stats.lastMs;
+	stats.updates++;
+}
+
+// the faces looking at the cell show its light: the 6 cubes around it, patched in their own chunks
+void Lighting::MarkChanged(World& world, uint32_t cell) {
+	using Dims = Chunk::Dims;
+	int x, y, z;
+	UnpackCell(cell, x, y, z);
+	for (int face = 0; face < Chunk::FACE_COUNT; face++) {
+		int nx = x + Chunk::FACE_DIRS[face][0];
+		int ny = y + Chunk::FACE_DIRS[face][1];
+		int nz = z + Chunk::FACE_DIRS[face][2];
+		if (!WORLD_BOUNDS.Contains(nx, ny, nz)) continue;
+		world.GetChunk(nx, ny, nz)->MarkVoxelDirty(Dims::ToLocal(nx), Dims::ToLocal(ny), Dims::ToLocal(nz), false);
+		// the nodes' faces are lit by the cells too
+		world.GetLod().MarkChunkDirty(Dims::ToChunk(nx), Dims::ToChunk(ny), Dims::ToChunk(nz));
+	}
+}
+
+void Lighting::ShowImGui() {
+	ImGui::Begin("Lighting");
+
+	ImGui::Text("Initial lighting %.1f ms on %d threads", stats.initialMs, stats.threads);
+	ImGui::Text("Last update: %d cells, %.3f ms", stats.lastCells, stats.lastMs);
+	ImGui::Text("%d updates, avg %.3f ms, max %.3f ms", stats.updates, stats.updates ? stats.totalMs / stats.updates : 0.0, stats.maxMs);
+
+	ImGui::End();
+}
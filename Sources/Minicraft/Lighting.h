@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Block.h"
+#include <utility>
+#include <vector>
+
+class World;
+
+// Sky and block light, 4 bits each per voxel, stored by the chunks (Chunk::GetChunkLight) as sky << 4 | block.
+// Both channels spread by BFS, losing 1 per step (2 through water). Sky light at 15 also goes straight down
+// without loss, that is what lights the open air.
+// Edits don't relight the world: the edited cells are cleared with the removal BFS (which collects the
+// neighbours still lit from elsewhere) and the add BFS refills from there, so the cost of an edit is bounded by
+// the volume its light reaches, whatever the world size.
+class Lighting {
+public:
+	constexpr static int MAX_LIGHT = 15;
+	constexpr static int SKY_SHIFT = 4;
+	constexpr static int BLOCK_SHIFT = 0;
+
+	struct Stats {
+		int lastCells = 0; // light values changed by the last update
+		double lastMs = 0;
+		double maxMs = 0;
+		int updates = 0;
+		double totalMs = 0;
+		double initialMs = 0; // last ComputeAll
+		int threads = 0;
+	};
+	// BFS queues, one set per thread during ComputeAll
+	struct Queues {
+		std::vector<uint32_t> add; // cells whose light must spread
+		std::vector<std::pair<uint32_t, uint8_t>> remove; // cells cleared, with the light they had
+	};
+private:
+	Queues queues;
+	Stats stats;
+public:
+	// whole world, in parallel per chunk column then one pass across the column borders
+	void ComputeAll(World& world);
+	// cells whose block or emission changed, already written in the world
+	void Update(World& world, const BlockEdit* cells, size_t count);
+
+	const Stats& GetStats() const { return stats; }
+	void ShowImGui();
+
+	// light lost entering the block, more than MAX_LIGHT when it stops light
+	static int GetAbsorption(BlockId id);
+	static int GetEmission(BlockId id, BlockState state);
+private:
+	void MarkChanged(World& world, uint32_t cell);
+};
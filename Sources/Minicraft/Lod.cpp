@@ -0,0 +1,273 @@
+#include "pch.h"
+
+#include "Lod.h"
+#include "World.h"
+
+void LodNode::SetPosition(World* world, int level, int nx, int ny, int nz) {
+	float size = (float)(CELLS << level);
+	mModel = Matrix::CreateTranslation(Vector3(nx, ny, nz) * size);
+	bounds = BoundingBox(Vector3(nx + 0.5f, ny + 0.5f, nz + 0.5f) * size, Vector3(size / 2.0f));
+	this->world = world;
+	this->level = level;
+	this->nx = nx;
+	this->ny = ny;
+	this->nz = nz;
+}
+
+void LodNode::Generate(DeviceResources* deviceRes) {
+	BuildMesh();
+	for (int pass = SP_OPAQUE; pass < SP_COUNT; pass++) {
+		vBuffer[pass].Create(deviceRes);
+		iBuffer[pass].Create(deviceRes);
+	}
+}
+
+void LodNode::BuildMesh() {
+	for (int pass = SP_OPAQUE; pass < SP_COUNT; pass++) {
+		vBuffer[pass].Clear();
+		iBuffer[pass].Clear();
+	}
+	std::array<BlockId, CELLS * CELLS * CELLS> cells;
+	for (int z = 0; z < CELLS; z++)
+		for (int y = 0; y < CELLS; y++)
+			for (int x = 0; x < CELLS; x++)
+				cells[Chunk::GetLocalIndex(x, y, z)] = Downsample(x, y, z);
+	for (int z = 0; z < CELLS; z++)
+		for (int y = 0; y < CELLS; y++)
+			for (int x = 0; x < CELLS; x++)
+				PushCell(cells, x, y, z);
+	dirty = false;
+}
+
+void LodNode::Draw(DeviceResources* deviceRes, ShaderPass pass) {
+	if (dirty) Generate(deviceRes);
+	if (iBuffer[pass].Size() == 0) return;
+	vBuffer[pass].Apply(deviceRes);
+	iBuffer[pass].Apply(deviceRes);
+	deviceRes->GetD3DDeviceContext()->DrawIndexed(iBuffer[pass].Size(), 0, 0);
+}
+
+int LodNode::GetTriangleCount() {
+	int triangles = 0;
+	for (int pass = SP_OPAQUE; pass < SP_COUNT; pass++)
+		triangles += iBuffer[pass].Size() / 3;
+	return triangles;
+}
+
+// majority vote over the voxels of the cell, the block comes from the top solid layer so grass stays on top
+BlockId LodNode::Downsample(int cx, int cy, int cz) {
+	const int size = GetCellSize();
+	const int x0 = (nx * CELLS + cx) * size, y0 = (ny * CELLS + cy) * size, z0 = (nz * CELLS + cz) * size;
+	int solid = 0, water = 0;
+	BlockId top = EMPTY;
+	for (int y = y0 + size - 1; y >= y0; y--) {
+		for (int z = z0; z < z0 + size; z++) {
+			for (int x = x0; x < x0 + size; x++) {
+				BlockId id = *world->ReadCube(x, y, z);
+				if (id == EMPTY) continue;
+				if (BlockTables::GetPass(id) == SP_TRANSPARENT) {
+					water++;
+					continue;
+				}
+				solid++;
+				if (top == EMPTY) top = id;
+			}
+		}
+	}
+	const int volume = size * size * size;
+	if (solid * 2 >= volume) return top;
+	if ((solid + water) * 2 >= volume) return WATER;
+	return EMPTY;
+}
+
+void LodNode::PushCell(const std::array<BlockId, CELLS * CELLS * CELLS>& cells, int cx, int cy, int cz) {
+	BlockId blockId = cells[Chunk::GetLocalIndex(cx, cy, cz)];
+	if (blockId == EMPTY) return;
+	ShaderPass pass = BlockTables::GetPass(blockId);
+	auto visible = [&](int dx, int dy, int dz) {
+		int x = cx + dx, y = cy + dy, z = cz + dz;
+		if (x < 0 || y < 0 || z < 0 || x >= CELLS || y >= CELLS || z >= CELLS) return IsSkirtNeeded(cx, cy, cz, dx, dy, dz);
+		return !BlockTables::Hides(blockId, cells[Chunk::GetLocalIndex(x, y, z)]);
+	};
+
+	const auto& side = BlockTables::GetUV(blockId, BlockTables::TF_SIDE);
+	float s = (float)GetCellSize();
+	Vector3 offset = Vector3(cx, cy, cz + 1) * s; // same corners as Chunk::PushCube, scaled
+	if (visible(0, 0, 1)) PushFace(offset + Vector3::Zero, Vector3::Up * s, Vector3::Right * s, Vector3::Forward, side, GetFaceLight(cx, cy, cz, 0, 0, 1), pass);
+	if (visible(1, 0, 0)) PushFace(offset + Vector3::Right * s, Vector3::Up * s, Vector3::Forward * s, Vector3::Left, side, GetFaceLight(cx, cy, cz, 1, 0, 0), pass);
+	if (visible(0, 0, -1)) PushFace(offset + (Vector3::Right + Vector3::Forward) * s, Vector3::Up * s, Vector3::Left * s, Vector3::Backward, side, GetFaceLight(cx, cy, cz, 0, 0, -1), pass);
+	if (visible(-1, 0, 0)) PushFace(offset + Vector3::Forward * s, Vector3::Up * s, Vector3::Backward * s, Vector3::Right, side, GetFaceLight(cx, cy, cz, -1, 0, 0), pass);
+	if (visible(0, 1, 0)) PushFace(offset + Vector3::Up * s, Vector3::Forward * s, Vector3::Right * s, Vector3::Down, BlockTables::GetUV(blockId, BlockTables::TF_TOP), GetFaceLight(cx, cy, cz, 0, 1, 0), pass);
+	if (visible(0, -1, 0)) PushFace(offset + (Vector3::Right + Vector3::Forward) * s, Vector3::Left * s, Vector3::Backward * s, Vector3::Up, BlockTables::GetUV(blockId, BlockTables::TF_BOTTOM), GetFaceLight(cx, cy, cz, 0, -1, 0), pass);
+}
+
+// Border face of the node: the neighbour may be drawn at another level, so its own voxels decide.
+// It can only be seen through a non-opaque voxel of the layer touching the face
+bool LodNode::IsSkirtNeeded(int cx, int cy, int cz, int dx, int dy, int dz) {
+	const int size = GetCellSize();
+	int x0 = (nx * CELLS + cx) * size, y0 = (ny * CELLS + cy) * size, z0 = (nz * CELLS + cz) * size;
+	int x1 = x0 + size, y1 = y0 + size, z1 = z0 + size;
+	// the layer just outside the face
+	if (dx) x0 = x1 = dx > 0 ? x1 : x0 - 1;
+	if (dy) y0 = y1 = dy > 0 ? y1 : y0 - 1;
+	if (dz) z0 = z1 = dz > 0 ? z1 : z0 - 1;
+	if (dx) x1++;
+	if (dy) y1++;
+	if (dz) z1++;
+	for (int z = z0; z < z1; z++) {
+		for (int y = y0; y < y1; y++) {
+			for (int x = x0; x < x1; x++) {
+				const BlockId* cube = world->ReadCube(x, y, z);
+				if (!cube || !BlockTables::IsOpaque(*cube)) return true;
+			}
+		}
+	}
+	return false;
+}
+
+// light of the voxel just outside the middle of the face
+Vector2 LodNode::GetFaceLight(int cx, int cy, int cz, int dx, int dy, int dz) {
+	const int size = GetCellSize();
+	int x = (nx * CELLS + cx) * size + size / 2 + (dx > 0 ? size / 2 : (dx < 0 ? -size / 2 - 1 : 0));
+	int y = (ny * CELLS + cy) * size + size / 2 + (dy > 0 ? size / 2 : (dy < 0 ? -size / 2 - 1 : 0));
+	int z = (nz * CELLS + cz) * size + size / 2 + (dz > 0 ? size / 2 : (dz < 0 ? -size / 2 - 1 : 0));
+	uint8_t* cell = world->GetLight(x, y, z);
+	uint8_t packed = cell ? *cell : (uint8_t)(Lighting::MAX_LIGHT << Lighting::SKY_SHIFT);
+	return Vector2(
+		((packed >> Lighting::SKY_SHIFT) & Lighting::MAX_LIGHT) / (float)Lighting::MAX_LIGHT,
+		((packed >> Lighting::BLOCK_SHIFT) & Lighting::MAX_LIGHT) / (float)Lighting::MAX_LIGHT);
+}
+
+// the texture tile is stretched over the whole face
+void LodNode::PushFace(Vector3 pos, Vector3 up, Vector3 right, Vector3 normal, const BlockTables::FaceUV& uv, Vector2 light, ShaderPass pass) {
+	uint32_t bottomLeft = vBuffer[pass].PushVertex(VertexLayout_PositionNormalUVLight(pos, normal, Vector2(uv.u0, uv.v1), light));
+	uint32_t bottomRight = vBuffer[pass].PushVertex(VertexLayout_PositionNormalUVLight(pos + right, normal, Vector2(uv.u1, uv.v1), light));
+	uint32_t upLeft = vBuffer[pass].PushVertex(VertexLayout_PositionNormalUVLight(pos + up, normal, Vector2(uv.u0, uv.v0), light));
+	uint32_t upRight = vBuffer[pass].PushVertex(VertexLayout_PositionNormalUVLight(pos + up + right, normal, Vector2(uv.u1, uv.v0), light));
+	iBuffer[pass].PushTriangle(bottomLeft, upLeft, upRight);
+	iBuffer[pass].PushTriangle(bottomLeft, upRight, bottomRight);
+}
+
+void LodMeshes::Init(World* world) {
+	for (int level = 1; level <= LEVEL_COUNT; level++) {
+		int count = World::WORLD_SIZE >> level;
+		auto& levelNodes = nodes[level - 1];
+		levelNodes.resize(count * count * count);
+		for (int z = 0; z < count; z++)
+			for (int y = 0; y < count; y++)
+				for (int x = 0; x < count; x++)
+					levelNodes[x + y * count + z * count * count].SetPosition(world, level, x, y, z);
+	}
+	covered.assign(World::WORLD_SIZE * World::WORLD_SIZE * World::WORLD_SIZE, false);
+}
+
+void LodMeshes::MarkChunkDirty(int cx, int cy, int cz) {
+	for (int level = 1; level <= LEVEL_COUNT; level++) {
+		int count = World::WORLD_SIZE >> level;
+		nodes[level - 1][(cx >> level) + (cy >> level) * count + (cz >> level) * count * count].MarkDirty();
+	}
+}
+
+void LodMeshes::MarkAllDirty() {
+	for (auto& levelNodes : nodes)
+		for (auto& node : levelNodes)
+			node.MarkDirty();
+}
+
+void LodMeshes::BuildMeshes() {
+	for (auto& levelNodes : nodes)
+		for (auto& node : levelNodes)
+			if (node.IsDirty()) node.BuildMesh();
+}
+
+void LodMeshes::Select(const Vector3& cameraPos, const BoundingFrustum& frustum, std::vector<Chunk*>& chunks) {
+	selected.clear();
+	stats = Stats();
+	for (Chunk* chunk : chunks)
+		stats.fullTriangles += chunk->GetTriangleCount();
+	if (!enabled) {
+		for (Chunk* chunk : chunks)
+			chunk->SetLodFaces(0);
+		stats.nodes[0] = (int)chunks.size();
+		stats.triangles = stats.fullTriangles;
+		return;
+	}
+
+	std::fill(covered.begin(), covered.end(), false);
+	int count = World::WORLD_SIZE >> LEVEL_COUNT;
+	for (int z = 0; z < count; z++)
+		for (int y = 0; y < count; y++)
+			for (int x = 0; x < count; x++)
+				SelectNode(LEVEL_COUNT, x, y, z, cameraPos, frustum);
+
+	size_t kept = 0;
+	for (Chunk* chunk : chunks) {
+		Vector3 center = chunk->GetBounds().Center;
+		int cx = (int)(center.x / Chunk::CHUNK_SIZE), cy = (int)(center.y / Chunk::CHUNK_SIZE), cz = (int)(center.z / Chunk::CHUNK_SIZE);
+		if (covered[World::GetChunkIndex(cx, cy, cz)]) continue;
+		chunks[kept++] = chunk;
+		// the full-res faces toward a node: its cells are coarser than the voxels that hid them
+		uint8_t lodFaces = 0;
+		for (int face = 0; face < Chunk::FACE_COUNT; face++) {
+			int nx = cx + Chunk::FACE_DIRS[face][0], ny = cy + Chunk::FACE_DIRS[face][1], nz = cz + Chunk::FACE_DIRS[face][2];
+			if (nx < 0 || ny < 0 || nz < 0 || nx >= World::WORLD_SIZE || ny >= World::WORLD_SIZE || nz >= World::WORLD_SIZE) continue;
+			if (covered[World::GetChunkIndex(nx, ny, nz)]) lodFaces |= 1 << face;
+		}
+		chunk->SetLodFaces(lodFaces);
+	}
+	chunks.resize(kept);
+
+	stats.nodes[0] = (int)kept;
+	for (Chunk* chunk : chunks)
+		stats.triangles += chunk->GetTriangleCount();
+	for (LodNode* node : selected) {
+		stats.nodes[node->GetLevel()]++;
+		stats.triangles += node->GetTriangleCount();
+	}
+}
+
+void LodMeshes::SelectNode(int level, int nx, int ny, int nz, const Vector3& cameraPos, const BoundingFrustum& frustum) {
+	int count = World::WORLD_SIZE >> level;
+	LodNode& node = nodes[level - 1][nx + ny * count + nz * count * count];
+	const BoundingBox& bounds = node.GetBounds();
+	Vector3 boxMin = Vector3(bounds.Center) - Vector3(bounds.Extents);
+	Vector3 boxMax = Vector3(bounds.Center) + Vector3(bounds.Extents);
+	Vector3 closest = Vector3::Min(Vector3::Max(cameraPos, boxMin), boxMax);
+
+	if (Vector3::Distance(cameraPos, closest) >= distances[level - 1]) {
+		// covered even out of the frustum: its chunks can't be seen either
+		int chunks = 1 << level;
+		for (int z = 0; z < chunks; z++)
+			for (int y = 0; y < chunks; y++)
+				for (int x = 0; x < chunks; x++)
+					covered[World::GetChunkIndex(nx * chunks + x, ny * chunks + y, nz * chunks + z)] = true;
+		if (frustum.Intersects(bounds)) selected.push_back(&node);
+		return;
+	}
+	if (level == 1) return; // close enough for the chunks
+	for (int i = 0; i < 8; i++)
+		SelectNode(level - 1, nx * 2 + (i & 1), ny * 2 + ((i >> 1) & 1), nz * 2 + (i >> 2), cameraPos, frustum);
+}
+
+int LodMeshes::GetTriangleCount(int level) {
+	int triangles = 0;
+	for (auto& node : nodes[level - 1])
+		triangles += node.GetTriangleCount();
+	return triangles;
+}
+
+void LodMeshes::ShowImGui() {
+	ImGui::Begin("LOD");
+
+	ImGui::Checkbox("Enabled", &enabled);
+	for (int level = 1; level <= LEVEL_COUNT; level++) {
+		char label[32];
+		snprintf(label, sizeof(label), "Level %d (%dx) past", level, 1 << level);
+		ImGui::DragFloat(label, &distances[level - 1], 1.0f, 0.0f, 1000.0f);
+	}
+	ImGui::Text("Drawn: %d chunks, %d / %d / %d nodes", stats.nodes[0], stats.nodes[1], stats.nodes[2], stats.nodes[3]);
+	ImGui::Text("%d triangles, %d with chunks only (%.1f%% less)", stats.triangles, stats.fullTriangles,
+		stats.fullTriangles ? 100.0f * (1.0f - stats.triangles / (float)stats.fullTriangles) : 0.0f);
+
+	ImGui::End();
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Engine/Buffer.h"
+#include "Engine/VertexLayout.h"
+#include "Chunk.h"
+#include <vector>
+
+class World;
+
+// Coarse mesh of a group of (2^level)^3 chunks: CHUNK_SIZE^3 cells of 2^level voxels per axis.
+// A cell is solid when most of its voxels are (it takes the block of its top solid layer), water when
+// most are solid or water. The neighbour of a node may be drawn at another level, so a face on the border
+// is emitted whenever a voxel across it is not opaque (skirts). The other way round, a chunk next to a node
+// meshes its faces toward it as if nothing was there (Chunk::SetLodFaces): nothing shows through the seams.
+class LodNode {
+public:
+	constexpr static int CELLS = Chunk::CHUNK_SIZE;
+private:
+	VertexBuffer<VertexLayout_PositionNormalUVLight> vBuffer[SP_COUNT];
+	IndexBuffer iBuffer[SP_COUNT];
+	BoundingBox bounds;
+	Matrix mModel;
+	World* world;
+	int level = 1;
+	int nx, ny, nz; // in nodes of this level
+	bool dirty = true;
+public:
+	void SetPosition(World* world, int level, int nx, int ny, int nz);
+	void MarkDirty() { dirty = true; }
+	bool IsDirty() const { return dirty; }
+	void Generate(DeviceResources* deviceRes);
+	// CPU side of Generate, no device needed
+	void BuildMesh();
+	void Draw(DeviceResources* deviceRes, ShaderPass pass);
+
+	int GetLevel() const { return level; }
+	int GetCellSize() const { return 1 << level; }
+	int GetTriangleCount();
+	const BoundingBox& GetBounds() const { return bounds; }
+	const Matrix& GetLocalMatrix() const { return mModel; }
+private:
+	BlockId Downsample(int cx, int cy, int cz);
+	void PushCell(const std::array<BlockId, CELLS * CELLS * CELLS>& cells, int cx, int cy, int cz);
+	bool IsSkirtNeeded(int cx, int cy, int cz, int dx, int dy, int dz);
+	Vector2 GetFaceLight(int cx, int cy, int cz, int dx, int dy, int dz);
+	void PushFace(Vector3 pos, Vector3 up, Vector3 right, Vector3 normal, const BlockTables::FaceUV& uv, Vector2 light, ShaderPass pass);
+};
+
+// LOD levels 1 to LEVEL_COUNT (2x, 4x, 8x) over the whole world. Select walks the nodes from the coarsest:
+// a node far enough from the camera is drawn as is, a closer one is split into its 8 children, down to the
+// chunks themselves. Node meshes are built lazily when drawn, like the chunks.
+class LodMeshes {
+public:
+	constexpr static int LEVEL_COUNT = 3;
+	struct Stats {
+		int nodes[LEVEL_COUNT + 1] = {}; // drawn per level, chunks in [0]
+		int triangles = 0; // drawn, chunks and nodes
+		int fullTriangles = 0; // the same view with chunks only
+	};
+private:
+	std::vector<LodNode> nodes[LEVEL_COUNT];
+	std::vector<LodNode*> selected;
+	std::vector<bool> covered; // per chunk, drawn by a node this frame
+	float distances[LEVEL_COUNT] = { 40.0f, 72.0f, 112.0f }; // a node of level l is used past distances[l - 1]
+	bool enabled = true;
+	Stats stats;
+public:
+	void Init(World* world);
+	void MarkChunkDirty(int cx, int cy, int cz);
+	void MarkAllDirty();
+	// CPU meshing of every dirty node, headless
+	void BuildMeshes();
+
+	// picks the nodes drawn from cameraPos and removes the chunks they cover from the list, the chunks kept next to
+	// a node get their faces toward it meshed
+	void Select(const Vector3& cameraPos, const BoundingFrustum& frustum, std::vector<Chunk*>& chunks);
+	const std::vector<LodNode*>& GetSelected() const { return selected; }
+	bool IsEnabled() const { return enabled; }
+	void SetEnabled(bool value) { enabled = value; }
+	int GetTriangleCount(int level);
+	const Stats& GetStats() const { return stats; }
+	void ShowImGui();
+private:
+	void SelectNode(int level, int nx, int ny, int nz, const Vector3& cameraPos, const BoundingFrustum& frustum);
+};
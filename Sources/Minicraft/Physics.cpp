@@ -0,0 +1,132 @@
+#include "pch.h"
+
+#include "Physics.h"
+#include "World.h"
+#include <cfloat>
+
+constexpr float SKIN = 1e-4f; // keeps the box from resting exactly on a voxel boundary
+
+bool GetBlockShape(BlockId id, AABB& shape) {
+	auto& blockData = BlockData::Get(id);
+	if (blockData.flags & BF_NO_PHYSICS) return false;
+	shape.min = Vector3::Zero;
+	shape.max = (blockData.flags & BF_HALF_BLOCK) ? Vector3(1, 0.5f, 1) : Vector3::One;
+	return true;
+}
+
+static float Component(const Vector3& v, int axis) {
+	return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+// clips the move of box along one axis against the blocks its swept volume overlaps
+static float SweepAxis(World& world, const AABB& box, int axis, float move) {
+	if (move == 0) return 0;
+	const float wanted = move;
+
+	Vector3 sweptMin = box.min;
+	Vector3 sweptMax = box.max;
+	if (axis == 0) { if (move > 0) sweptMax.x += move; else sweptMin.x += move; }
+	if (axis == 1) { if (move > 0) sweptMax.y += move; else sweptMin.y += move; }
+	if (axis == 2) { if (move > 0) sweptMax.z += move; else sweptMin.z += move; }
+
+	int x0 = (int)floor(sweptMin.x), x1 = (int)floor(sweptMax.x - SKIN);
+	int y0 = (int)floor(sweptMin.y), y1 = (int)floor(sweptMax.y - SKIN);
+	int z0 = (int)floor(sweptMin.z), z1 = (int)floor(sweptMax.z - SKIN);
+
+	float boxMin = Component(box.min, axis);
+	float boxMax = Component(box.max, axis);
+	for (int z = z0; z <= z1; z++) {
+		for (int y = y0; y <= y1; y++) {
+			for (int x = x0; x <= x1; x++) {
+				const BlockId* block = world.ReadCube(x, y, z);
+				AABB shape;
+				if (!block || !GetBlockShape(*block, shape)) continue;
+				shape.Translate(Vector3((float)x, (float)y, (float)z));
+
+				// must overlap on the two other axes to be in the way
+				if (axis != 0 && (shape.max.x <= box.min.x + SKIN || shape.min.x >= box.max.x - SKIN)) continue;
+				if (axis != 1 && (shape.max.y <= box.min.y + SKIN || shape.min.y >= box.max.y - SKIN)) continue;
+				if (axis != 2 && (shape.max.z <= box.min.z + SKIN || shape.min.z >= box.max.z - SKIN)) continue;
+
+				float shapeMin = Component(shape.min, axis);
+				float shapeMax = Component(shape.max, axis);
+				if (move > 0 && shapeMin >= boxMax - SKIN)
+					move = std::min(move, shapeMin - boxMax - SKIN);
+				else if (move < 0 && shapeMax <= boxMin + SKIN)
+					move = std::max(move, shapeMax - boxMin + SKIN);
+			}
+		}
+	}
+	// resting against a block (inside the skin) must not push us backward
+	if ((wanted > 0 && move < 0) || (wanted < 0 && move > 0)) move = 0;
+	return move;
+}
+
+CollisionResult MoveAndCollide(World& world, AABB& box, const Vector3& delta) {
+	CollisionResult result;
+
+	// Y first so we land / hit the ceiling before sliding on the walls
+	float dy = SweepAxis(world, box, 1, delta.y);
+	box.Translate(Vector3(0, dy, 0));
+	result.hitY = dy != delta.y;
+	result.onGround = result.hitY && delta.y < 0;
+
+	float dx = SweepAxis(world, box, 0, delta.x);
+	box.Translate(Vector3(dx, 0, 0));
+	result.hitX = dx != delta.x;
+
+	float dz = SweepAxis(world, box, 2, delta.z);
+	box.Translate(Vector3(0, 0, dz));
+	result.hitZ = dz != delta.z;
+
+	result.moved = Vector3(dx, dy, dz);
+	return result;
+}
+
+bool IntersectRay(const AABB& box, const Vector3& origin, const Vector3& invDir, float maxDistance, float& distance) {
+	float t0 = 0, t1 = maxDistance;
+	const float o[3] = { origin.x, origin.y, origin.z };
+	const float inv[3] = { invDir.x, invDir.y, invDir.z };
+	const float lo[3] = { box.min.x, box.min.y, box.min.z };
+	const float hi[3] = { box.max.x, box.max.y, box.max.z };
+	for (int axis = 0; axis < 3; axis++) {
+		float ta = (lo[axis] - o[axis]) * inv[axis];
+		float tb = (hi[axis] - o[axis]) * inv[axis];
+		if (ta > tb) std::swap(ta, tb);
+		t0 = std::max(t0, ta);
+		t1 = std::min(t1, tb);
+		if (t0 > t1) return false;
+	}
+	distance = t0;
+	return true;
+}
+
+GridRay::GridRay(const Vector3& origin, const Vector3& dir, float cellSize) {
+	const float o[3] = { origin.x / cellSize, origin.y / cellSize, origin.z / cellSize };
+	const float d[3] = { dir.x, dir.y, dir.z };
+	for (int axis = 0; axis < 3; axis++) {
+		cell[axis] = (int)floor(o[axis]);
+		if (d[axis] > 0) {
+			step[axis] = 1;
+			tDelta[axis] = cellSize / d[axis];
+			tMax[axis] = (cell[axis] + 1 - o[axis]) * tDelta[axis];
+		} else if (d[axis] < 0) {
+			step[axis] = -1;
+			tDelta[axis] = -cellSize / d[axis];
+			tMax[axis] = (o[axis] - cell[axis]) * tDelta[axis];
+		} else {
+			step[axis] = 0;
+			tDelta[axis] = tMax[axis] = FLT_MAX;
+		}
+	}
+}
+
+void GridRay::Next() {
+	int axis = 0;
+	if (tMax[1] < tMax[axis]) axis = 1;
+	if (tMax[2] < tMax[axis]) axis = 2;
+	t = tMax[axis];
+	tMax[axis] += tDelta[axis];
+	cell[axis] += step[axis];
+	face = axis;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Block.h"
+
+using namespace DirectX::SimpleMath;
+class World;
+
+struct AABB {
+	Vector3 min;
+	Vector3 max;
+
+	static AABB FromFeet(const Vector3& feet, float halfWidth, float height) {
+		return { feet - Vector3(halfWidth, 0, halfWidth), feet + Vector3(halfWidth, height, halfWidth) };
+	}
+	void Translate(const Vector3& delta) { min += delta; max += delta; }
+};
+
+struct CollisionResult {
+	Vector3 moved; // what was actually applied, component by component
+	bool hitX = false;
+	bool hitY = false;
+	bool hitZ = false;
+	bool onGround = false; // hit something while moving down
+};
+
+// Collision shape of a block in its own unit cube, false if the block has no physics
+bool GetBlockShape(BlockId id, AABB& shape);
+
+// Swept AABB against the voxel grid: moves along Y, then X, then Z, each time clipping the move
+// against every solid block of the swept volume so nothing tunnels whatever the speed.
+// No allocation, usable for any entity.
+CollisionResult MoveAndCollide(World& world, AABB& box, const Vector3& delta);
+
+// Slab test, invDir is 1 / dir per component. distance is where the ray enters the box (0 if it starts inside)
+bool IntersectRay(const AABB& box, const Vector3& origin, const Vector3& invDir, float maxDistance, float& distance);
+
+// Voxel DDA (Amanatides & Woo): visits every cell of a grid crossed by a ray, in order, without allocating.
+// cellSize is 1 for the voxels, Chunk::CHUNK_SIZE for the chunk grid.
+struct GridRay {
+	int cell[3];
+	int step[3];
+	float tMax[3]; // distance at which the ray leaves the current cell along each axis
+	float tDelta[3]; // distance to cross a whole cell along each axis
+	float t = 0; // distance at which the ray entered the current cell
+	int face = -1; // axis crossed to enter the current cell, -1 for the start cell
+
+	GridRay(const Vector3& origin, const Vector3& dir, float cellSize = 1.0f);
+	void Next();
+};
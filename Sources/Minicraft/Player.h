@@ -5,20 +5,41 @@
 class World;
 
 class Player {
+public:
+	constexpr static float HALF_WIDTH = 0.3f;
+	constexpr static float HEIGHT = 1.8f;
+	constexpr static float GRAVITY = 48.0f; // blocks / s^2
+	constexpr static float JUMP_SPEED = 18.0f; // blocks / s
+	constexpr static float WALK_SPEED = 10.0f; // blocks / s
+	constexpr static float LOOK_SPEED = 0.2f / 60.0f; // radians per mouse count
+private:
 	World* world;
 	Camera camera = Camera(60, 1.0f);
 
-	Vector3 position = Vector3(25, 25, 25);
-	Vector3 velocity;
+	Vector3 position;
+	Vector3 previousPosition = position; // position at the previous tick, for render interpolation
+	Vector3 velocity; // blocks / s
 
 	float yaw;
 	float pitch;
 
 	Keyboard::KeyboardStateTracker kbTracker;
 	Mouse::ButtonStateTracker msTracker;
+	// edges seen since the last tick: kept over frames without a tick, consumed by the next one
+	bool jumpPressed = false, breakPressed = false, usePressed = false;
 public:
 	void SetWorld(World* world) { this->world = world; }
-	void Update(float dt, const Keyboard::State& kb, const Mouse::State& ms);
+	// teleport, cf World::GetSpawnPosition
+	void SetPosition(const Vector3& feet) { position = previousPosition = feet; velocity = Vector3::Zero; }
+	// once per rendered frame, before the ticks: the trackers must see each state once to find the edges
+	void UpdateInput(const Keyboard::State& kb, const Mouse::State& ms);
+	// fixed rate simulation tick: movement, physics, block interaction
+	void Update(float dt, const Keyboard::State& kb);
+	// once per rendered frame: mouse look, and eye placed between the last two ticks (alpha in [0, 1))
+	void UpdateCamera(const Mouse::State& ms, float alpha);
 
 	Camera& GetCamera() { return camera; }
+private:
+	// first raycastable block within reach of the eye
+	bool PickBlock(int cell[3]);
 };
\ No newline at end of file
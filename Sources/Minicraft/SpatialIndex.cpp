@@ -0,0 +1,99 @@
+#include "pch.h"
+
+#include "SpatialIndex.h"
+#include "World.h"
+
+constexpr int GRID_SIZE = World::WORLD_SIZE;
+
+SpatialIndex::SpatialIndex() {
+	cells.resize(GRID_SIZE * GRID_SIZE * GRID_SIZE);
+}
+
+void SpatialIndex::Insert(EntityId id, const Vector3& point, float extent) {
+	if (id >= entries.size()) entries.resize(id + 1);
+	maxExtent = std::max(maxExtent, extent);
+	if (entries[id].cell >= 0) {
+		Move(id, point);
+		return;
+	}
+	AddToCell(id, GetCellIndex(point));
+	count++;
+}
+
+void SpatialIndex::Move(EntityId id, const Vector3& point) {
+	int cell = GetCellIndex(point);
+	if (cell == entries[id].cell) return;
+	RemoveFromCell(id);
+	AddToCell(id, cell);
+}
+
+void SpatialIndex::Remove(EntityId id) {
+	if (id >= entries.size() || entries[id].cell < 0) return;
+	RemoveFromCell(id);
+	entries[id].cell = -1;
+	count--;
+}
+
+void SpatialIndex::Clear() {
+	for (auto& cell : cells)
+		cell.clear();
+	entries.clear();
+	maxExtent = 0;
+	count = 0;
+}
+
+int SpatialIndex::GetCellIndex(const Vector3& point) {
+	int cx, cy, cz;
+	GetCellCoords(point, cx, cy, cz);
+	return GetCellIndex(cx, cy, cz);
+}
+
+int SpatialIndex::GetCellIndex(int cx, int cy, int cz) {
+	return World::GetChunkIndex(cx, cy, cz);
+}
+
+void SpatialIndex::GetCellCoords(const Vector3& point, int& cx, int& cy, int& cz) {
+	auto toCell = [](float v) {
+		return std::clamp((int)floor(v / Chunk::CHUNK_SIZE), 0, GRID_SIZE - 1);
+	};
+	cx = toCell(point.x);
+	cy = toCell(point.y);
+	cz = toCell(point.z);
+}
+
+void SpatialIndex::AddToCell(EntityId id, int cell) {
+	entries[id].cell = cell;
+	entries[id].slot = (uint32_t)cells[cell].size();
+	cells[cell].push_back(id);
+}
+
+// swap-remove: the last id of the cell takes the hole
+void SpatialIndex::RemoveFromCell(EntityId id) {
+	auto& cell = cells[entries[id].cell];
+	uint32_t slot = entries[id].slot;
+	EntityId last = cell.back();
+	cell[slot] = last;
+	entries[last].slot = slot;
+	cell.pop_back();
+}
+
+uint32_t SpatialIndex::NextStamp() {
+	// on wrap around, old stamps could collide with the new ones
+	if (++queryStamp == 0) {
+		for (auto& entry : entries)
+			entry.stamp = 0;
+		queryStamp = 1;
+	}
+	return queryStamp;
+}
+
+// once every axis is either still or out of the grid and moving away, the clamped cells can't change anymore
+bool SpatialIndex::IsRayDone(const GridRay& ray) {
+	for (int axis = 0; axis < 3; axis++) {
+		bool away = ray.step[axis] == 0
+			|| (ray.step[axis] < 0 && ray.cell[axis] < 0)
+			|| (ray.step[axis] > 0 && ray.cell[axis] >= GRID_SIZE);
+		if (!away) return false;
+	}
+	return true;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "Physics.h"
+#include "Chunk.h"
+#include <vector>
+
+using EntityId = uint32_t;
+
+// Entity broadphase on the chunk grid (the cells of World::GetChunk). Each entity is filed under the cell of
+// one reference point (its feet), points outside the world are clamped to the border cells. The grid is loose:
+// queries grow by maxExtent, how far an entity can reach out of its cell, so Move only touches the index
+// when the point changes chunk, which is rare.
+// The index doesn't know the shapes: queries hand every candidate to a caller test (the narrow phase) and
+// write into caller buffers, deduping with a per-entry stamp, so nothing allocates on the query path.
+class SpatialIndex {
+public:
+	struct RayHit {
+		EntityId id;
+		float distance;
+	};
+private:
+	struct Entry {
+		int cell = -1; // -1 when the id is free
+		uint32_t slot = 0; // position in its cell, for the O(1) removal
+		uint32_t stamp = 0;
+	};
+
+	std::vector<Entry> entries; // indexed by id
+	std::vector<std::vector<EntityId>> cells;
+	float maxExtent = 0;
+	uint32_t queryStamp = 0;
+	int count = 0;
+public:
+	SpatialIndex();
+
+	// extent: distance the entity can reach from point, on any axis
+	void Insert(EntityId id, const Vector3& point, float extent);
+	void Move(EntityId id, const Vector3& point);
+	void Remove(EntityId id);
+	void Clear();
+	int GetCount() const { return count; }
+	static int GetCellIndex(const Vector3& point);
+
+	// test(id) decides if a candidate is written, the return value is the number of ids written, at most capacity
+	template<typename Test>
+	int Query(const AABB& bounds, EntityId* out, int capacity, Test&& test);
+	// nearest entity along the ray, walking the chunk cells with the voxel DDA.
+	// intersect(id, maxDistance, distance) is the narrow phase, returns true with the distance on a hit
+	template<typename Intersect>
+	bool Raycast(const Vector3& origin, const Vector3& dir, float maxDistance, RayHit& hit, Intersect&& intersect);
+private:
+	void AddToCell(EntityId id, int cell);
+	void RemoveFromCell(EntityId id);
+	uint32_t NextStamp();
+	// visits the ids of the cells overlapped by bounds grown by maxExtent, once each per stamp
+	template<typename Visit>
+	void VisitCells(const AABB& bounds, uint32_t stamp, Visit&& visit);
+	static void GetCellCoords(const Vector3& point, int& cx, int& cy, int& cz);
+	static int GetCellIndex(int cx, int cy, int cz);
+	static bool IsRayDone(const GridRay& ray);
+};
+
+template<typename Visit>
+void SpatialIndex::VisitCells(const AABB& bounds, uint32_t stamp, Visit&& visit) {
+	int x0, y0, z0, x1, y1, z1;
+	GetCellCoords(bounds.min - Vector3(maxExtent), x0, y0, z0);
+	GetCellCoords(bounds.max + Vector3(maxExtent), x1, y1, z1);
+	for (int cz = z0; cz <= z1; cz++) {
+		for (int cy = y0; cy <= y1; cy++) {
+			for (int cx = x0; cx <= x1; cx++) {
+				for (EntityId id : cells[GetCellIndex(cx, cy, cz)]) {
+					Entry& entry = entries[id];
+					if (entry.stamp == stamp) continue;
+					entry.stamp = stamp;
+					if (!visit(id)) return;
+				}
+			}
+		}
+	}
+}
+
+template<typename Test>
+int SpatialIndex::Query(const AABB& bounds, EntityId* out, int capacity, Test&& test) {
+	int found = 0;
+	if (capacity <= 0) return 0;
+	VisitCells(bounds, NextStamp(), [&](EntityId id) {
+		if (test(id)) out[found++] = id;
+		return found < capacity;
+	});
+	return found;
+}
+
+template<typename Intersect>
+bool SpatialIndex::Raycast(const Vector3& origin, const Vector3& dir, float maxDistance, RayHit& hit, Intersect&& intersect) {
+	uint32_t stamp = NextStamp();
+	hit.distance = maxDistance;
+	hit.id = ~0u;
+
+	// cells are visited in ray order, each step looks at the cells around the piece of ray inside the current
+	// one (the grid is loose). Stop as soon as the next piece starts behind the best hit
+	GridRay ray(origin, dir, (float)Chunk::CHUNK_SIZE);
+	for (; ray.t <= hit.distance; ray.Next()) {
+		float tExit = std::min(std::min(ray.tMax[0], ray.tMax[1]), std::min(ray.tMax[2], hit.distance));
+		Vector3 a = origin + dir * ray.t;
+		Vector3 b = origin + dir * tExit;
+		VisitCells({ Vector3::Min(a, b), Vector3::Max(a, b) }, stamp, [&](EntityId id) {
+			float distance;
+			if (intersect(id, hit.distance, distance) && distance < hit.distance) {
+				hit.distance = distance;
+				hit.id = id;
+			}
+			return true;
+		});
+		if (IsRayDone(ray)) break;
+	}
+	return hit.id != ~0u;
+}
@@ -2,47 +2,69 @@
 
 #include "World.h"
 #include "Engine/Camera.h"
-#include "PerlinNoise.hpp"
 
 using namespace DirectX::SimpleMath;
 
-float perlinScaleStone = 0.02f;
-int perlinOctaveStone = 4;
-float perlinHeightStone = 14.0f;
-float perlinScaleDirt = 0.07f;
-int perlinOctaveDirt = 2;
-float perlinHeightDirt = 8.0f;
-float waterHeight = 11.0f;
+constexpr int GLOBAL_SIZE = World::WORLD_SIZE * Chunk::CHUNK_SIZE;
 
-void World::Generate() {
-	siv::BasicPerlinNoise<float> perlin;
-	const int GLOBAL_SIZE = WORLD_SIZE * Chunk::CHUNK_SIZE;
+static bool IsSolid(BlockId id) { return id != EMPTY && !(BlockTables::GetFlags(id) & BF_NO_PHYSICS); }
+static bool IsLightBlocking(BlockId id) { return Lighting::GetAbsorption(id) > 1; }
 
-	for (int z = 0; z < GLOBAL_SIZE; z++) {
-		for (int x = 0; x < GLOBAL_SIZE; x++) {
-			for (int y = 0; y < GLOBAL_SIZE; y++)
-				SetCube(x, y, z, EMPTY);
+static_assert(GLOBAL_SIZE <= 128, "a column mask holds 128 cells");
 
-			int yStone = perlin.octave2D_01(x * perlinScaleStone, z * perlinScaleStone, perlinOctaveStone) * perlinHeightStone;
-			int yDirt = yStone + perlin.octave2D_01(x * perlinScaleDirt, z * perlinScaleDirt, perlinOctaveDirt) * perlinHeightDirt;
+static int HighestBit(uint64_t bits) {
+#ifdef _MSC_VER
+	unsigned long index;
+	return _BitScanReverse64(&index, bits) ? (int)index : -1;
+#else
+	return bits ? 63 - __builtin_clzll(bits) : -1;
+#endif
+}
 
-			for (int y = 0; y < yStone; y++) {
-				SetCube(x, y, z, STONE);
-			}
+static int GetColumnHeight(const std::array<uint64_t, 2>& mask) {
+	return mask[1] ? 64 + HighestBit(mask[1]) : HighestBit(mask[0]);
+}
 
-			for (int y = yStone; y < yDirt; y++) {
-				SetCube(x, y, z, DIRT);
-			}
+static void SetColumnBit(std::array<uint64_t, 2>& mask, int y, bool set) {
+	uint64_t bit = 1ull << (y & 63);
+	if (set) mask[y >> 6] |= bit;
+	else mask[y >> 6] &= ~bit;
+}
 
-			if ((yDirt + 1) < waterHeight) {
-				SetCube(x, yDirt, z, DIRT); // on mets tout de meme un bloc de dirt pour ne pas faire un trop gros saut dans la generation
-				for (int y = yDirt+1; y < waterHeight; y++) {
-					SetCube(x, y, z, WATER);
+World::World() {
+	for (int z = 0; z < WORLD_SIZE; z++) {
+		for (int y = 0; y < WORLD_SIZE; y++) {
+			for (int x = 0; x < WORLD_SIZE; x++) {
+				Chunk& chunk = chunks[GetChunkIndex(x, y, z)];
+				chunk.SetPosition(this, x, y, z);
+				for (int face = 0; face < Chunk::FACE_COUNT; face++) {
+					int nx = x + Chunk::FACE_DIRS[face][0];
+					int ny = y + Chunk::FACE_DIRS[face][1];
+					int nz = z + Chunk::FACE_DIRS[face][2];
+					bool inside = Grid::IsInside(nx) && Grid::IsInside(ny) && Grid::IsInside(nz);
+					chunk.SetNeighbour(face, inside ? &chunks[GetChunkIndex(nx, ny, nz)] : nullptr);
 				}
 			}
-			else {
-				SetCube(x, yDirt, z, GRASS);
-			}
+		}
+	}
+	editStamps.resize(chunks.size(), 0);
+	solidColumns.resize(GLOBAL_SIZE * GLOBAL_SIZE, ColumnMask{});
+	lightColumns.resize(GLOBAL_SIZE * GLOBAL_SIZE, ColumnMask{});
+	lod.Init(this);
+	for (int z = 0; z < BATCH_SIZE; z++)
+		for (int y = 0; y < BATCH_SIZE; y++)
+			for (int x = 0; x < BATCH_SIZE; x++)
+				batches[x + y * BATCH_SIZE + z * BATCH_SIZE * BATCH_SIZE].SetPosition(this, x, y, z);
+}
+
+void World::Generate() {
+	WorldGenerator generator(genParams);
+
+	for (int z = 0; z < GLOBAL_SIZE; z++) {
+		for (int x = 0; x < GLOBAL_SIZE; x++) {
+			WorldGenerator::Column column = generator.GetColumn(x, z);
+			for (int y = 0; y < GLOBAL_SIZE; y++)
+				*GetCube(x, y, z) = generator.GetBlock(column, y);
 
 			/*for (int y = 0; y < GLOBAL_SIZE; y++) {
 				float test = perlin.octave3D_01(x / (float)GLOBAL_SIZE * 0.8f, y / (float)GLOBAL_SIZE * 0.8f, z / (float)GLOBAL_SIZE * 0.8f, 5);
@@ -62,103 +84,493 @@ void World::Generate() {
 			SetCube(x, 6, z, GRASS);
 		}
 	}*/
+
+	// a freshly generated world has nothing to persist: the save only keeps what differs from the generator
+	for (auto& chunk : chunks) {
+		chunk.ClearStates();
+		chunk.MarkDirty();
+		chunk.ClearPersistDirty();
+	}
+	persistDirtyChunks.clear();
+	edits.clear();
+	blockTicks.Clear();
+	explosions.Clear();
+	RebuildHeightmaps();
+	lighting.ComputeAll(*this);
+	lod.MarkAllDirty();
+	horizon.Reset(genParams, GLOBAL_SIZE);
 }
 
+// the device buffers are created by the first Draw: the opaque meshes only live in the batches
 void World::CreateMesh(DeviceResources * res) {
-	for (int z = 0; z < WORLD_SIZE; z++) {
-		for (int y = 0; y < WORLD_SIZE; y++) {
-			for (int x = 0; x < WORLD_SIZE; x++) {
-				chunks[x + y * WORLD_SIZE + z * WORLD_SIZE * WORLD_SIZE].SetPosition(this, x, y, z);
-				chunks[x + y * WORLD_SIZE + z * WORLD_SIZE * WORLD_SIZE].Generate(res);
-			}
-		}
-	}
+	for (auto& chunk : chunks)
+		chunk.UpdateMesh();
+	for (auto& batch : batches)
+		batch.UpdateMesh();
 	cbModel.Create(res);
 }
 
-void World::Draw(DeviceResources* res, Camera* camera, ShaderPass pass) {
-	cbModel.ApplyToVS(res, 0);
+void World::Cull(Camera* camera) {
+	if (recordingPath)
+		cameraPath.push_back({ camera->GetPosition(), camera->GetViewMatrix(), camera->GetProjectionMatrix() });
 
-	for (auto& chunk : chunks) {
-		if (!camera->GetBounds().Intersects(chunk.GetBounds()))
-			continue;
+	cullStats = CullFromCamera(*camera, caveCulling, occlusionCulling, visibleChunks);
+	// far chunks are swapped for the LOD nodes covering them
+	lod.Select(camera->GetPosition(), camera->GetBounds(), visibleChunks);
+	cullStats.drawn = (int)visibleChunks.size();
+	GroupBatches(visibleChunks, visibleBatches);
+}
 
-		Matrix model = chunk.GetLocalMatrix();
+void World::GroupBatches(const std::vector<Chunk*>& chunkList, std::vector<std::pair<ChunkBatch*, ChunkBatch::BrickMask>>& out) {
+	out.clear();
+	for (Chunk* chunk : chunkList) {
+		int cx, cy, cz;
+		GetChunkCoords((int)(chunk - chunks.data()), cx, cy, cz);
+		ChunkBatch* batch = &GetBatch(cx, cy, cz);
+		auto it = std::find_if(out.begin(), out.end(), [&](const auto& entry) { return entry.first == batch; });
+		if (it == out.end()) it = out.insert(out.end(), { batch, ChunkBatch::BrickMask() });
+		it->second[ChunkBatch::GetBrickIndex(cx, cy, cz)] = true;
+	}
+}
+
+void World::Draw(DeviceResources* res, ShaderPass pass) {
+	cbModel.ApplyToVS(res, 0);
+
+	// the list is front to back: good for early-z when opaque, reversed for blending
+	auto drawChunk = [&](Chunk* chunk) {
+		if (chunk->IsEmpty()) return;
+		Matrix model = chunk->GetLocalMatrix();
 		cbModel.data.mModel = model.Transpose();
 		cbModel.Update(res);
-		chunk.Draw(res, pass);
+		chunk->Draw(res, pass);
+	};
+	// the LOD nodes are all farther than the chunks
+	auto drawNodes = [&]() {
+		for (LodNode* node : lod.GetSelected()) {
+			cbModel.data.mModel = node->GetLocalMatrix().Transpose();
+			cbModel.Update(res);
+			node->Draw(res, pass);
+		}
+	};
+	if (pass == SP_TRANSPARENT) {
+		drawNodes();
+		std::for_each(visibleChunks.rbegin(), visibleChunks.rend(), drawChunk);
+	} else {
+		// a batch comes when its first visible chunk does, its bricks are drawn in their buffer order
+		cullStats.drawCalls = 0;
+		for (auto& [batch, visible] : visibleBatches) {
+			cbModel.data.mModel = batch->GetLocalMatrix().Transpose();
+			cbModel.Update(res);
+			cullStats.drawCalls += batch->Draw(res, visible);
+		}
+		drawNodes();
 	}
 }
 
-BlockId* World::GetCube(int gx, int gy, int gz) {
-	int cx = gx / Chunk::CHUNK_SIZE;
-	int cy = gy / Chunk::CHUNK_SIZE;
-	int cz = gz / Chunk::CHUNK_SIZE;
-	int lx = gx % Chunk::CHUNK_SIZE;
-	int ly = gy % Chunk::CHUNK_SIZE;
-	int lz = gz % Chunk::CHUNK_SIZE;
+World::CullStats World::CullFromCamera(const Camera& camera, bool cave, bool occlusion, std::vector<Chunk*>& out) {
+	CullStats stats;
+	CollectVisibleChunks(camera.GetPosition(), camera.GetBounds(), cave, out, stats);
+	if (occlusion)
+		ApplyOcclusionCulling(camera.GetPosition(), camera.GetViewMatrix() * camera.GetProjectionMatrix(), out, stats);
+	stats.drawn = (int)out.size();
+	return stats;
+}
+
+void World::CollectVisibleChunks(const Vector3& cameraPos, const BoundingFrustum& frustum, bool cave, std::vector<Chunk*>& out, CullStats& stats) {
+	out.clear();
+	stats = CullStats();
+	stats.total = (int)chunks.size();
+	for (auto& chunk : chunks)
+		if (frustum.Intersects(chunk.GetBounds())) stats.frustumVisible++;
+
+	int camCx = (int)floor(cameraPos.x / Chunk::CHUNK_SIZE);
+	int camCy = (int)floor(cameraPos.y / Chunk::CHUNK_SIZE);
+	int camCz = (int)floor(cameraPos.z / Chunk::CHUNK_SIZE);
+	bool insideWorld = camCx >= 0 && camCy >= 0 && camCz >= 0 && camCx < WORLD_SIZE && camCy < WORLD_SIZE && camCz < WORLD_SIZE;
+
+	// outside of the world there is no starting chunk, fall back to frustum culling only
+	if (!cave || !insideWorld) {
+		for (auto& chunk : chunks)
+			if (frustum.Intersects(chunk.GetBounds())) out.push_back(&chunk);
+		stats.reached = (int)out.size();
+		return;
+	}
+
+	struct Step {
+		int index;
+		int8_t entryFace; // face of this chunk we came in through, -1 for the camera chunk
+		uint8_t directions; // every FACE_x we already stepped through, we never step back toward the camera
+	};
+	std::vector<Step> queue;
+	std::vector<bool> visited(chunks.size(), false);
+	queue.reserve(chunks.size());
 
-	if (cx < 0) return nullptr;
-	if (cy < 0) return nullptr;
-	if (cz < 0) return nullptr;
-	if (cx >= WORLD_SIZE) return nullptr;
-	if (cy >= WORLD_SIZE) return nullptr;
-	if (cz >= WORLD_SIZE) return nullptr;
+	int startIndex = GetChunkIndex(camCx, camCy, camCz);
+	queue.push_back({ startIndex, -1, 0 });
+	visited[startIndex] = true;
+	for (size_t head = 0; head < queue.size(); head++) {
+		Step step = queue[head];
+		Chunk& chunk = chunks[step.index];
+		stats.visited++;
+		if (step.entryFace >= 0 && !frustum.Intersects(chunk.GetBounds())) continue;
+		out.push_back(&chunk);
 
-	return chunks[cx + cy * WORLD_SIZE + cz * WORLD_SIZE * WORLD_SIZE].GetChunkCube(lx, ly, lz);
+		int cx, cy, cz;
+		GetChunkCoords(step.index, cx, cy, cz);
+		for (int face = 0; face < Chunk::FACE_COUNT; face++) {
+			if (step.directions & (1 << Chunk::OppositeFace(face))) continue;
+			if (step.entryFace >= 0 && !chunk.AreFacesConnected(step.entryFace, face)) continue;
+
+			int nx = cx + Chunk::FACE_DIRS[face][0];
+			int ny = cy + Chunk::FACE_DIRS[face][1];
+			int nz = cz + Chunk::FACE_DIRS[face][2];
+			if (nx < 0 || ny < 0 || nz < 0 || nx >= WORLD_SIZE || ny >= WORLD_SIZE || nz >= WORLD_SIZE) continue;
+			int neighbour = GetChunkIndex(nx, ny, nz);
+			if (visited[neighbour]) continue;
+			visited[neighbour] = true;
+			queue.push_back({ neighbour, (int8_t)Chunk::OppositeFace(face), (uint8_t)(step.directions | (1 << face)) });
+		}
+	}
+	stats.reached = (int)out.size();
+}
+
+void World::ApplyOcclusionCulling(const Vector3& cameraPos, const Matrix& viewProj, std::vector<Chunk*>& inOut, CullStats& stats) {
+	occlusionBuffer.Clear(viewProj);
+
+	// the budget goes to the closest chunks with opaque layers, whatever the order of the list
+	occluderCandidates.clear();
+	for (Chunk* chunk : inOut) {
+		float distance = Vector3::Distance(cameraPos, chunk->GetBounds().Center);
+		if (distance <= occluderDistance) occluderCandidates.push_back({ distance, chunk });
+	}
+	std::sort(occluderCandidates.begin(), occluderCandidates.end(),
+		[](const auto& a, const auto& b) { return a.first < b.first; });
+
+	stats.occluders = 0;
+	for (auto& candidate : occluderCandidates) {
+		if (stats.occluders >= maxOccluders) break;
+		Vector3 boxMin[3], boxMax[3];
+		int count = candidate.second->GetOccluders(boxMin, boxMax);
+		for (int i = 0; i < count; i++)
+			occlusionBuffer.RasterizeBox(boxMin[i], boxMax[i]);
+		stats.occluders += count > 0;
+	}
+	occlusionBuffer.BuildHiZ();
+
+	size_t kept = 0;
+	for (Chunk* chunk : inOut) {
+		const BoundingBox& bounds = chunk->GetBounds();
+		Vector3 center = bounds.Center;
+		Vector3 extents = bounds.Extents;
+		if (occlusionBuffer.IsVisible(center - extents, center + extents))
+			inOut[kept++] = chunk;
+	}
+	stats.occluded = (int)(inOut.size() - kept);
+	inOut.resize(kept);
+}
+
+World::CullStats World::EvaluateCameraPath(int& frames) {
+	CullStats sum;
+	std::vector<Chunk*> chunkList;
+	for (auto& sample : cameraPath) {
+		BoundingFrustum frustum;
+		BoundingFrustum::CreateFromMatrix(frustum, sample.proj, true);
+		frustum.Transform(frustum, sample.view.Invert());
+
+		CullStats frame;
+		CollectVisibleChunks(sample.position, frustum, caveCulling, chunkList, frame);
+		if (occlusionCulling)
+			ApplyOcclusionCulling(sample.position, sample.view * sample.proj, chunkList, frame);
+		frame.drawn = (int)chunkList.size();
+
+		sum.total += frame.total;
+		sum.frustumVisible += frame.frustumVisible;
+		sum.reached += frame.reached;
+		sum.visited += frame.visited;
+		sum.occluders += frame.occluders;
+		sum.occluded += frame.occluded;
+		sum.drawn += frame.drawn;
+	}
+	frames = (int)cameraPath.size();
+	return sum;
+}
+
+BlockId* World::GetCube(int gx, int gy, int gz) {
+	if ((unsigned)gx >= GLOBAL_SIZE || (unsigned)gy >= GLOBAL_SIZE || (unsigned)gz >= GLOBAL_SIZE) return nullptr;
+	using Dims = Chunk::Dims;
+	Chunk& chunk = chunks[GetChunkIndex(Dims::ToChunk(gx), Dims::ToChunk(gy), Dims::ToChunk(gz))];
+	return chunk.GetChunkCube(Dims::ToLocal(gx), Dims::ToLocal(gy), Dims::ToLocal(gz));
+}
+
+const BlockId* World::ReadCube(int gx, int gy, int gz) const {
+	if ((unsigned)gx >= GLOBAL_SIZE || (unsigned)gy >= GLOBAL_SIZE || (unsigned)gz >= GLOBAL_SIZE) return nullptr;
+	using Dims = Chunk::Dims;
+	const Chunk& chunk = chunks[GetChunkIndex(Dims::ToChunk(gx), Dims::ToChunk(gy), Dims::ToChunk(gz))];
+	return chunk.GetChunkCube(Dims::ToLocal(gx), Dims::ToLocal(gy), Dims::ToLocal(gz));
 }
 
 void World::SetCube(int gx, int gy, int gz, BlockId id) {
+	using Dims = Chunk::Dims;
 	auto cube = GetCube(gx, gy, gz);
 	if (!cube) return;
+	BlockId previous = *cube;
+	// nothing to redraw, relight or save, and the state of the block stays
+	if (previous == id) return;
 	*cube = id;
-	MarkCubeDirty(gx, gy, gz);
+	MarkCubeDirty(gx, gy, gz, previous);
+	UpdateHeightmaps(gx, gy, gz, id);
+
+	edits.push_back({ gx, gy, gz, id });
+	Chunk* chunk = GetChunk(gx, gy, gz);
+	chunk->SetState(Dims::ToLocal(gx), Dims::ToLocal(gy), Dims::ToLocal(gz), 0);
+	if (chunk->MarkPersistDirty())
+		persistDirtyChunks.push_back(GetChunkIndex(Dims::ToChunk(gx), Dims::ToChunk(gy), Dims::ToChunk(gz)));
+	BlockEdit edit = { gx, gy, gz, id };
+	lighting.Update(*this, &edit, 1);
+	blockTicks.Notify(*this, gx, gy, gz);
 }
 
-Chunk* World::GetChunk(int gx, int gy, int gz) {
-	int cx = gx / Chunk::CHUNK_SIZE;
-	int cy = gy / Chunk::CHUNK_SIZE;
-	int cz = gz / Chunk::CHUNK_SIZE;
+int World::ApplyEdits(const std::vector<BlockEdit>& batch) {
+	using Dims = Chunk::Dims;
+	// 0 is the initial value of every stamp
+	if (++editStamp == 0) {
+		std::fill(editStamps.begin(), editStamps.end(), 0);
+		editStamp = 1;
+	}
+	int dirtyChunks = 0;
+	appliedEdits.clear();
+	auto markChunk = [&](int cx, int cy, int cz) {
+		if (cx < 0 || cy < 0 || cz < 0 || cx >= WORLD_SIZE || cy >= WORLD_SIZE || cz >= WORLD_SIZE) return;
+		int index = GetChunkIndex(cx, cy, cz);
+		if (editStamps[index] == editStamp) return;
+		editStamps[index] = editStamp;
+		dirtyChunks++;
+	};
+
+	for (auto& edit : batch) {
+		auto cube = GetCube(edit.gx, edit.gy, edit.gz);
+		if (!cube || *cube == edit.id) continue;
+		BlockId previous = *cube;
+		*cube = edit.id;
+		edits.push_back(edit);
+		appliedEdits.push_back(edit);
+		UpdateHeightmaps(edit.gx, edit.gy, edit.gz, edit.id);
+
+		int cx = Dims::ToChunk(edit.gx);
+		int cy = Dims::ToChunk(edit.gy);
+		int cz = Dims::ToChunk(edit.gz);
+		int index = GetChunkIndex(cx, cy, cz);
+		if (chunks[index].MarkPersistDirty())
+			persistDirtyChunks.push_back(index);
+
+		chunks[index].SetState(Dims::ToLocal(edit.gx), Dims::ToLocal(edit.gy), Dims::ToLocal(edit.gz), 0);
+		int markedFaces = MarkCubeDirty(edit.gx, edit.gy, edit.gz, previous);
+		markChunk(cx, cy, cz);
+		for (int face = 0; face < Chunk::FACE_COUNT; face++)
+			if (markedFaces & (1 << face))
+				markChunk(cx + Chunk::FACE_DIRS[face][0], cy + Chunk::FACE_DIRS[face][1], cz + Chunk::FACE_DIRS[face][2]);
+	}
 
-	if (cx < 0) return nullptr;
-	if (cy < 0) return nullptr;
-	if (cz < 0) return nullptr;
-	if (cx >= WORLD_SIZE) return nullptr;
-	if (cy >= WORLD_SIZE) return nullptr;
-	if (cz >= WORLD_SIZE) return nullptr;
+	// one relight for the whole batch, the removals and refills of neighbouring edits merge
+	if (!appliedEdits.empty())
+		lighting.Update(*this, appliedEdits.data(), appliedEdits.size());
+	for (auto& edit : appliedEdits)
+		blockTicks.Notify(*this, edit.gx, edit.gy, edit.gz);
+	return dirtyChunks;
+}
 
-	return &chunks[cx + cy * WORLD_SIZE + cz * WORLD_SIZE * WORLD_SIZE];
+void World::Tick() {
+	explosions.Tick(*this);
+	blockTicks.Tick(*this);
+}
+
+BlockState World::GetState(int gx, int gy, int gz) {
+	using Dims = Chunk::Dims;
+	Chunk* chunk = GetChunk(gx, gy, gz);
+	if (!chunk || !ReadCube(gx, gy, gz)) return 0;
+	return chunk->GetState(Dims::ToLocal(gx), Dims::ToLocal(gy), Dims::ToLocal(gz));
+}
+
+void World::SetState(int gx, int gy, int gz, BlockState state) {
+	using Dims = Chunk::Dims;
+	auto cube = ReadCube(gx, gy, gz);
+	if (!cube || !(BlockTables::GetFlags(*cube) & BF_HAS_STATE)) return;
+	Chunk* chunk = GetChunk(gx, gy, gz);
+	const int lx = Dims::ToLocal(gx), ly = Dims::ToLocal(gy), lz = Dims::ToLocal(gz);
+	if (chunk->GetState(lx, ly, lz) == state) return;
+	// only the faces of the block change, its chunk is enough
+	chunk->SetState(lx, ly, lz, state);
+	// saved like a block edit: journaled, and the chunk goes to its region with the states
+	edits.push_back({ gx, gy, gz, *cube, state });
+	if (chunk->MarkPersistDirty())
+		persistDirtyChunks.push_back(GetChunkIndex(Dims::ToChunk(gx), Dims::ToChunk(gy), Dims::ToChunk(gz)));
+	// a lit furnace emits
+	BlockEdit edit = { gx, gy, gz, *cube };
+	lighting.Update(*this, &edit, 1);
+}
+
+uint8_t* World::GetLight(int gx, int gy, int gz) {
+	// called for every step of the light BFS: one bounds test on the global coordinates
+	if ((unsigned)gx >= GLOBAL_SIZE || (unsigned)gy >= GLOBAL_SIZE || (unsigned)gz >= GLOBAL_SIZE) return nullptr;
+	using Dims = Chunk::Dims;
+	Chunk& chunk = chunks[GetChunkIndex(Dims::ToChunk(gx), Dims::ToChunk(gy), Dims::ToChunk(gz))];
+	return chunk.GetChunkLight(Dims::ToLocal(gx), Dims::ToLocal(gy), Dims::ToLocal(gz));
+}
+
+int World::GetSolidHeight(int gx, int gz) const {
+	if ((unsigned)gx >= GLOBAL_SIZE || (unsigned)gz >= GLOBAL_SIZE) return -1;
+	return GetColumnHeight(solidColumns[gx + gz * GLOBAL_SIZE]);
+}
+
+int World::GetLightBlockingHeight(int gx, int gz) const {
+	if ((unsigned)gx >= GLOBAL_SIZE || (unsigned)gz >= GLOBAL_SIZE) return -1;
+	return GetColumnHeight(lightColumns[gx + gz * GLOBAL_SIZE]);
+}
+
+void World::RebuildHeightmaps() {
+	for (int z = 0; z < GLOBAL_SIZE; z++) {
+		for (int x = 0; x < GLOBAL_SIZE; x++) {
+			ColumnMask solid = {}, light = {};
+			for (int y = 0; y < GLOBAL_SIZE; y++) {
+				BlockId id = *ReadCube(x, y, z);
+				SetColumnBit(solid, y, IsSolid(id));
+				SetColumnBit(light, y, IsLightBlocking(id));
+			}
+			solidColumns[x + z * GLOBAL_SIZE] = solid;
+			lightColumns[x + z * GLOBAL_SIZE] = light;
+		}
+	}
+}
+
+int World::CheckHeightmaps() {
+	std::vector<ColumnMask> solid = solidColumns, light = lightColumns;
+	RebuildHeightmaps();
+	int mismatches = 0;
+	for (size_t i = 0; i < solid.size(); i++)
+		mismatches += solid[i] != solidColumns[i] || light[i] != lightColumns[i];
+	solidColumns.swap(solid);
+	lightColumns.swap(light);
+	return mismatches;
+}
+
+Vector3 World::GetSpawnPosition() const {
+	int center = GLOBAL_SIZE / 2;
+	return Vector3(center + 0.5f, GetSolidHeight(center, center) + 1.0f, center + 0.5f);
+}
+
+// one bit per predicate: O(1) whatever the edit, the query reads the highest set bit
+void World::UpdateHeightmaps(int gx, int gy, int gz, BlockId id) {
+	int column = gx + gz * GLOBAL_SIZE;
+	SetColumnBit(solidColumns[column], gy, IsSolid(id));
+	SetColumnBit(lightColumns[column], gy, IsLightBlocking(id));
+}
+
+Chunk* World::GetChunk(int gx, int gy, int gz) {
+	if ((unsigned)gx >= GLOBAL_SIZE || (unsigned)gy >= GLOBAL_SIZE || (unsigned)gz >= GLOBAL_SIZE) return nullptr;
+	using Dims = Chunk::Dims;
+	return &chunks[GetChunkIndex(Dims::ToChunk(gx), Dims::ToChunk(gy), Dims::ToChunk(gz))];
 }
 
 void World::MarkChunkDirty(int gx, int gy, int gz) {
+	using Dims = Chunk::Dims;
 	Chunk* chunk = GetChunk(gx, gy, gz);
-	if (chunk) chunk->MarkDirty();
+	if (!chunk) return;
+	chunk->MarkDirty();
+	lod.MarkChunkDirty(Dims::ToChunk(gx), Dims::ToChunk(gy), Dims::ToChunk(gz));
 }
 
-void World::MarkCubeDirty(int gx, int gy, int gz) {
-	MarkChunkDirty(gx, gy, gz);
-	MarkChunkDirty(gx + 1, gy, gz);
-	MarkChunkDirty(gx - 1, gy, gz);
-	MarkChunkDirty(gx, gy - 1, gz);
-	MarkChunkDirty(gx, gy + 1, gz);
-	MarkChunkDirty(gx, gy, gz - 1);
-	MarkChunkDirty(gx, gy, gz + 1);
+// the faces of the cube across `face` that look at the edited cube, or its water surface when it is just below
+static bool IsFaceChanged(BlockId neighbour, BlockId previous, BlockId current, int face) {
+	if (neighbour == EMPTY) return false;
+	if (BlockTables::Hides(neighbour, previous) != BlockTables::Hides(neighbour, current)) return true;
+	return face == Chunk::FACE_NEG_Y && (BlockTables::GetFlags(neighbour) & BF_GRAVITY_WATER) &&
+		(GetWaterLevel(previous) != 0) != (GetWaterLevel(current) != 0);
+}
+
+// the cube was `previous` and is already written: one chunk lookup, the neighbour cubes in the same chunk are
+// read from it, another chunk is only touched when the cube is on their shared face and its faces changed
+int World::MarkCubeDirty(int gx, int gy, int gz, BlockId previous) {
+	using Dims = Chunk::Dims;
+	if ((unsigned)gx >= GLOBAL_SIZE || (unsigned)gy >= GLOBAL_SIZE || (unsigned)gz >= GLOBAL_SIZE) return 0;
+	const int cx = Dims::ToChunk(gx), cy = Dims::ToChunk(gy), cz = Dims::ToChunk(gz);
+	const int lx = Dims::ToLocal(gx), ly = Dims::ToLocal(gy), lz = Dims::ToLocal(gz);
+	Chunk& chunk = chunks[GetChunkIndex(cx, cy, cz)];
+	// read only: a snapshot of the neighbours doesn't make them clone their blocks
+	BlockId current = *std::as_const(chunk).GetChunkCube(lx, ly, lz);
+	chunk.MarkVoxelDirty(lx, ly, lz, true);
+	lod.MarkChunkDirty(cx, cy, cz);
+
+	int markedFaces = 0;
+	for (int face = 0; face < Chunk::FACE_COUNT; face++) {
+		const int* dir = Chunk::FACE_DIRS[face];
+		if (const BlockId* inside = std::as_const(chunk).GetChunkCube(lx + dir[0], ly + dir[1], lz + dir[2])) {
+			if (IsFaceChanged(*inside, previous, current, face))
+				chunk.MarkVoxelDirty(lx + dir[0], ly + dir[1], lz + dir[2], false);
+			continue;
+		}
+		int nx = gx + dir[0], ny = gy + dir[1], nz = gz + dir[2];
+		if ((unsigned)nx >= GLOBAL_SIZE || (unsigned)ny >= GLOBAL_SIZE || (unsigned)nz >= GLOBAL_SIZE) continue;
+		// the LOD skirts of the neighbour look across the shared face whatever the faces did
+		lod.MarkChunkDirty(cx + dir[0], cy + dir[1], cz + dir[2]);
+		Chunk& other = chunks[GetChunkIndex(cx + dir[0], cy + dir[1], cz + dir[2])];
+		int ox = Dims::ToLocal(nx), oy = Dims::ToLocal(ny), oz = Dims::ToLocal(nz);
+		if (!IsFaceChanged(*std::as_const(other).GetChunkCube(ox, oy, oz), previous, current, face)) continue;
+		other.MarkVoxelDirty(ox, oy, oz, false);
+		markedFaces |= 1 << face;
+	}
+	return markedFaces;
 }
 
-void World::ShowImGui(DeviceResources* res) {
+bool World::ShowImGui(DeviceResources* res) {
 	ImGui::Begin("World gen");
 
-	ImGui::DragFloat("perlinScaleStone", &perlinScaleStone, 0.01f);
-	ImGui::DragInt("perlinOctaveStone", &perlinOctaveStone, 0.1f);
-	ImGui::DragFloat("perlinHeightStone", &perlinHeightStone, 0.1f);
-	ImGui::DragFloat("perlinScaleDirt", &perlinScaleDirt, 0.01f);
-	ImGui::DragInt("perlinOctaveDirt", &perlinOctaveDirt, 0.1f);
-	ImGui::DragFloat("perlinHeightDirt", &perlinHeightDirt, 0.1f);
+	int seed = (int)genParams.seed;
+	if (ImGui::InputInt("seed", &seed))
+		genParams.seed = (uint32_t)seed;
+	ImGui::DragFloat("perlinScaleStone", &genParams.perlinScaleStone, 0.01f);
+	ImGui::DragInt("perlinOctaveStone", &genParams.perlinOctaveStone, 0.1f);
+	ImGui::DragFloat("perlinHeightStone", &genParams.perlinHeightStone, 0.1f);
+	ImGui::DragFloat("perlinScaleDirt", &genParams.perlinScaleDirt, 0.01f);
+	ImGui::DragInt("perlinOctaveDirt", &genParams.perlinOctaveDirt, 0.1f);
+	ImGui::DragFloat("perlinHeightDirt", &genParams.perlinHeightDirt, 0.1f);
+	ImGui::DragFloat("waterHeight", &genParams.waterHeight, 0.1f);
+
+	ImGui::Separator();
+	ImGui::Checkbox("Cave culling", &caveCulling);
+	ImGui::Checkbox("Occlusion culling", &occlusionCulling);
+	ImGui::DragFloat("Occluder distance", &occluderDistance, 1.0f, 0.0f, 500.0f);
+	ImGui::DragInt("Max occluders", &maxOccluders, 1.0f, 0, 4096);
+	ImGui::Text("Chunks: %d total, %d in frustum, %d reached (%d visited)", cullStats.total, cullStats.frustumVisible, cullStats.reached, cullStats.visited);
+	ImGui::Text("Occlusion: %d occluders, %d occluded, %d drawn", cullStats.occluders, cullStats.occluded, cullStats.drawn);
+	ImGui::Text("Batches: %d opaque draw calls for %d batches", cullStats.drawCalls, (int)visibleBatches.size());
 
+	ImGui::Checkbox("Record camera path", &recordingPath);
+	ImGui::SameLine();
+	ImGui::Text("%d frames", (int)cameraPath.size());
+	if (ImGui::Button("Evaluate path"))
+		pathStats = EvaluateCameraPath(pathFrames);
+	ImGui::SameLine();
+	if (ImGui::Button("Clear path"))
+		cameraPath.clear();
+	if (pathFrames > 0 && pathStats.frustumVisible > 0) {
+		ImGui::Text("Path avg: %.1f in frustum, %.1f reached, %.1f drawn (%.1f%% culled after frustum)",
+			pathStats.frustumVisible / (float)pathFrames, pathStats.reached / (float)pathFrames, pathStats.drawn / (float)pathFrames,
+			100.0f * (1.0f - pathStats.drawn / (float)pathStats.frustumVisible));
+	}
+
+	bool generated = false;
 	if (ImGui::Button("Generate!")) {
 		Generate();
 		CreateMesh(res);
+		generated = true;
 	}
 
 	ImGui::End();
+
+	blockTicks.ShowImGui();
+	explosions.ShowImGui();
+	lighting.ShowImGui();
+	lod.ShowImGui();
+	horizon.ShowImGui();
+	return generated;
 }
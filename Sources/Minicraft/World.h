@@ -3,29 +3,160 @@
 #include "Block.h"
 #include "Cube.h"
 #include "Chunk.h"
+#include "ChunkBatch.h"
+#include "ChunkCursor.h"
+#include "WorldGenerator.h"
+#include "BlockTicks.h"
+#include "Explosions.h"
+#include "Lighting.h"
+#include "Lod.h"
+#include "Horizon.h"
+#include "Engine/OcclusionBuffer.h"
 #include <array>
 
 class Camera;
 
 class World {
+public:
 	constexpr static int WORLD_SIZE = 16;
+	using Grid = ChunkDims<WORLD_SIZE>; // order of the chunks in the array
+	constexpr static int BATCH_SIZE = WORLD_SIZE / ChunkBatch::BRICKS; // batches per axis
+private:
 	std::array<Chunk, WORLD_SIZE * WORLD_SIZE * WORLD_SIZE> chunks;
+	std::array<ChunkBatch, BATCH_SIZE * BATCH_SIZE * BATCH_SIZE> batches;
+	std::vector<int> persistDirtyChunks; // chunk indices edited since they were last handed to the saver
+	std::vector<BlockEdit> edits; // SetCube calls since the saver last drained them into its journal
+	WorldGenParams genParams;
+	BlockTicks blockTicks;
+	Explosions explosions;
+	Lighting lighting;
+	LodMeshes lod;
+	Horizon horizon;
+	std::vector<uint32_t> editStamps; // per chunk, last ApplyEdits call that marked it dirty
+	uint32_t editStamp = 0;
+	std::vector<BlockEdit> appliedEdits; // scratch of ApplyEdits, the edits of the batch that changed a cube
+	// per column (gx + gz * GLOBAL_SIZE), bit y set when the block matches, the height is the highest set bit
+	using ColumnMask = std::array<uint64_t, 2>;
+	std::vector<ColumnMask> solidColumns; // blocks with collision
+	std::vector<ColumnMask> lightColumns; // blocks dimming the sky light (opaque or water)
+
+	std::vector<Chunk*> visibleChunks; // result of the last Cull, front to back
+	std::vector<std::pair<ChunkBatch*, ChunkBatch::BrickMask>> visibleBatches; // the same grouped per batch
+	bool caveCulling = true;
+	bool occlusionCulling = true;
+	float occluderDistance = 48.0f;
+	int maxOccluders = 192;
+	OcclusionBuffer occlusionBuffer;
+	std::vector<std::pair<float, Chunk*>> occluderCandidates; // distance to the camera, scratch of the occlusion pass
+
+	struct CameraSample {
+		Vector3 position;
+		Matrix view;
+		Matrix proj;
+	};
+	std::vector<CameraSample> cameraPath;
+	bool recordingPath = false;
 
 	struct CubeData {
 		Matrix mModel;
 	};
 	ConstantBuffer<CubeData> cbModel;
 public:
+	struct CullStats {
+		int total = 0;
+		int frustumVisible = 0; // what plain frustum culling would draw
+		int reached = 0; // chunks reached by the visibility BFS (what we draw)
+		int visited = 0; // chunks popped by the BFS, including frustum rejected ones
+		int occluders = 0;
+		int occluded = 0; // rejected by the occlusion buffer
+		int drawn = 0;
+		int drawCalls = 0; // opaque pass, one per run of visible bricks in a batch
+	};
+private:
+	CullStats cullStats;
+	CullStats pathStats; // summed over the recorded camera path
+	int pathFrames = 0;
+public:
+	World();
+
 	void Generate();
 	void CreateMesh(DeviceResources* res);
-	void Draw(DeviceResources* res, Camera* camera, ShaderPass pass);
+	// builds the list of chunks drawn this frame, call it once before the Draw passes
+	void Cull(Camera* camera);
+	void Draw(DeviceResources* res, ShaderPass pass);
+	// what Cull keeps for any camera, headless: frustum culling, the BFS if cave, then the occlusion buffer if occlusion.
+	// Far chunks are not swapped for LOD nodes
+	CullStats CullFromCamera(const Camera& camera, bool cave, bool occlusion, std::vector<Chunk*>& out);
+	// cave culling: BFS from the camera chunk through connected faces, frustum culling only if !cave
+	void CollectVisibleChunks(const Vector3& cameraPos, const BoundingFrustum& frustum, bool cave, std::vector<Chunk*>& out, CullStats& stats);
+	// software occlusion: rasterizes the nearby occluders of the list then drops what is hidden behind them
+	void ApplyOcclusionCulling(const Vector3& cameraPos, const Matrix& viewProj, std::vector<Chunk*>& inOut, CullStats& stats);
+	// replays the recorded camera path through the whole culling pipeline, headless
+	CullStats EvaluateCameraPath(int& frames);
+	const CullStats& GetCullStats() const { return cullStats; }
 
+	// writable: clones the blocks of the chunk if a snapshot holds them, ReadCube when only reading
 	BlockId* GetCube(int gx, int gy, int gz);
+	const BlockId* ReadCube(int gx, int gy, int gz) const;
 	void SetCube(int gx, int gy, int gz, BlockId id);
+	// writing a cube resets its state, set it after the cube
+	BlockState GetState(int gx, int gy, int gz);
+	void SetState(int gx, int gy, int gz, BlockState state);
+	// writes a batch of cubes, each touched chunk (and border neighbour) is marked dirty once,
+	// returns the number of chunks marked dirty
+	int ApplyEdits(const std::vector<BlockEdit>& batch);
+	// one simulation tick of the explosions and of the scheduled blocks (water, sand...)
+	void Tick();
+	BlockTicks& GetBlockTicks() { return blockTicks; }
+	Explosions& GetExplosions() { return explosions; }
+	// sky << 4 | block light of the cell, nullptr outside of the world
+	uint8_t* GetLight(int gx, int gy, int gz);
+	// relights the whole world, after Generate does it or a load replaced the chunks
+	void ComputeLighting() { lighting.ComputeAll(*this); }
+	Lighting& GetLighting() { return lighting; }
+	LodMeshes& GetLod() { return lod; }
+	Horizon& GetHorizon() { return horizon; }
+
+	// O(1) column queries, kept up to date by SetCube and ApplyEdits
+	int GetSolidHeight(int gx, int gz) const;
+	int GetLightBlockingHeight(int gx, int gz) const;
+	// after writing cubes directly (Generate, loaded regions)
+	void RebuildHeightmaps();
+	// number of columns that differ from a rebuild, 0 when the index is consistent
+	int CheckHeightmaps();
+	// feet on the highest solid block in the middle of the world
+	Vector3 GetSpawnPosition() const;
 
 	Chunk* GetChunk(int gx, int gy, int gz);
+	// the cell as a cursor that walks its neighbours through the chunk links, invalid outside of the world
+	ChunkCursor GetCursor(int gx, int gy, int gz) {
+		using Dims = Chunk::Dims;
+		return ChunkCursor(GetChunk(gx, gy, gz), Dims::ToLocal(gx), Dims::ToLocal(gy), Dims::ToLocal(gz));
+	}
+	Chunk& GetChunkByIndex(int index) { return chunks[index]; }
+	ChunkBatch& GetBatch(int cx, int cy, int cz) {
+		constexpr int B = ChunkBatch::BRICKS;
+		return batches[cx / B + (cy / B) * BATCH_SIZE + (cz / B) * BATCH_SIZE * BATCH_SIZE];
+	}
+	// visible chunks grouped per batch in the order of their first chunk, as the opaque pass draws them
+	void GroupBatches(const std::vector<Chunk*>& chunkList, std::vector<std::pair<ChunkBatch*, ChunkBatch::BrickMask>>& out);
+	static int GetChunkIndex(int cx, int cy, int cz) { return Grid::Index(cx, cy, cz); }
+	static void GetChunkCoords(int index, int& cx, int& cy, int& cz) {
+		cx = Grid::IndexX(index);
+		cy = Grid::IndexY(index);
+		cz = Grid::IndexZ(index);
+	}
+	std::vector<int>& GetPersistDirtyChunks() { return persistDirtyChunks; }
+	std::vector<BlockEdit>& GetEdits() { return edits; }
 	void MarkChunkDirty(int gx, int gy, int gz);
-	void MarkCubeDirty(int gx, int gy, int gz);
+	// the cube was previous before the edit: its faces and the faces around that look at it.
+	// Returns the faces (bit per Chunk::Face) across which a neighbour chunk got marked
+	int MarkCubeDirty(int gx, int gy, int gz, BlockId previous);
+
+	WorldGenParams& GetGenParams() { return genParams; }
 
-	void ShowImGui(DeviceResources* res);
+	// returns true when the world has been regenerated
+	bool ShowImGui(DeviceResources* res);
+private:
+	void UpdateHeightmaps(int gx, int gy, int gz, BlockId id);
 };
\ No newline at end of file
@@ -0,0 +1,42 @@
+#include "pch.h"
+
+#include "WorldGenerator.h"
+
+WorldGenerator::WorldGenerator(const WorldGenParams& params) : params(params) {
+	if (params.seed != 0)
+		perlin.reseed(params.seed);
+}
+
+WorldGenerator::Column WorldGenerator::GetColumn(int gx, int gz) const {
+	Column column;
+	column.yStone = perlin.octave2D_01(gx * params.perlinScaleStone, gz * params.perlinScaleStone, params.perlinOctaveStone) * params.perlinHeightStone;
+	column.yDirt = column.yStone + perlin.octave2D_01(gx * params.perlinScaleDirt, gz * params.perlinScaleDirt, params.perlinOctaveDirt) * params.perlinHeightDirt;
+	return column;
+}
+
+BlockId WorldGenerator::GetBlock(const Column& column, int gy) const {
+	if (gy < column.yStone) return STONE;
+	if (gy < column.yDirt) return DIRT;
+	if (gy == column.yDirt) {
+		// on mets tout de meme un bloc de dirt pour ne pas faire un trop gros saut dans la generation
+		return ((column.yDirt + 1) < params.waterHeight) ? DIRT : GRASS;
+	}
+	if (gy < params.waterHeight) return WATER;
+	return EMPTY;
+}
+
+template<class Dims>
+void WorldGenerator::GenerateChunk(int cx, int cy, int cz, typename Dims::Data& out) const {
+	for (int lz = 0; lz < Dims::SIZE; lz++) {
+		for (int lx = 0; lx < Dims::SIZE; lx++) {
+			Column column = GetColumn(cx * Dims::SIZE + lx, cz * Dims::SIZE + lz);
+			for (int ly = 0; ly < Dims::SIZE; ly++)
+				out[Dims::Index(lx, ly, lz)] = GetBlock(column, cy * Dims::SIZE + ly);
+		}
+	}
+}
+
+template void WorldGenerator::GenerateChunk<ChunkDims<8>>(int, int, int, ChunkDims<8>::Data&) const;
+template void WorldGenerator::GenerateChunk<ChunkDims<16>>(int, int, int, ChunkDims<16>::Data&) const;
+template void WorldGenerator::GenerateChunk<ChunkDims<32>>(int, int, int, ChunkDims<32>::Data&) const;
+template void WorldGenerator::GenerateChunk<ChunkDims<8, MortonLayout>>(int, int, int, ChunkDims<8, MortonLayout>::Data&) const;
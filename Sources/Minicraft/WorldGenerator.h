@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Chunk.h"
+#include "PerlinNoise.hpp"
+
+// Everything needed to rebuild a world from scratch, this is what a save stores instead of the terrain itself
+struct WorldGenParams {
+	uint32_t seed = 0; // 0 keeps the reference permutation of siv::PerlinNoise
+	float perlinScaleStone = 0.02f;
+	int perlinOctaveStone = 4;
+	float perlinHeightStone = 14.0f;
+	float perlinScaleDirt = 0.07f;
+	int perlinOctaveDirt = 2;
+	float perlinHeightDirt = 8.0f;
+	float waterHeight = 11.0f;
+};
+
+// Deterministic terrain function: the same params always give the same blocks,
+// it does not touch the World so it can be used from any thread
+class WorldGenerator {
+	WorldGenParams params;
+	siv::BasicPerlinNoise<float> perlin;
+public:
+	struct Column {
+		int yStone;
+		int yDirt;
+	};
+
+	WorldGenerator(const WorldGenParams& params);
+
+	Column GetColumn(int gx, int gz) const;
+	BlockId GetBlock(const Column& column, int gy) const;
+	// blocks of chunk (cx, cy, cz) of any size, instantiated for the sides 8, 16 and 32
+	template<class Dims>
+	void GenerateChunk(int cx, int cy, int cz, typename Dims::Data& out) const;
+	void GenerateChunk(int cx, int cy, int cz, Chunk::Data& out) const { GenerateChunk<Chunk::Dims>(cx, cy, cz, out); }
+};
@@ -0,0 +1,544 @@
+#include "pch.h"
+
+#include "WorldSaver.h"
+#include "World.h"
+#include <filesystem>
+#include <io.h>
+#include <set>
+
+constexpr uint32_t REGION_MAGIC = 0x4752434D; // "MCRG"
+constexpr uint32_t REGION_FORMAT_VERSION = 3;
+constexpr uint32_t HEADER_MAGIC = 0x4457434D; // "MCWD"
+constexpr uint32_t HEADER_FORMAT_VERSION = 2;
+
+static void SyncFile(FILE* file) {
+	fflush(file);
+	_commit(_fileno(file));
+}
+
+// A payload is its type, the block states (u16 count, then (u16 voxel index, u8 state) entries), then the blocks
+enum PayloadType : uint8_t {
+	PAYLOAD_FULL, // RLE of the whole chunk
+	PAYLOAD_SPARSE, // u16 count, then (u16 voxel index, u8 block id) entries
+};
+constexpr int REGIONS_PER_AXIS = World::WORLD_SIZE / WorldSaver::REGION_SIZE;
+
+WorldSaver::~WorldSaver() {
+	Stop();
+}
+
+void WorldSaver::Open(const std::string& directory, World& world) {
+	Stop();
+	this->directory = directory;
+	std::filesystem::create_directories(directory);
+
+	WorldGenParams params;
+	if (ReadHeader(params)) {
+		world.GetGenParams() = params;
+		world.Generate();
+		ApplyRegions(world);
+		// the regions replaced whole chunks under the heightmaps and the light of the generated world,
+		// the replay then updates both incrementally
+		world.RebuildHeightmaps();
+		world.ComputeLighting();
+		ReplayJournal(world);
+		StartWorker(params);
+		// the replayed edits only live in the journal, fold them into the regions right away
+		if (stats.replayedEdits > 0)
+			Compact(world);
+	} else {
+		world.Generate();
+		NewWorld(world);
+	}
+}
+
+void WorldSaver::NewWorld(World& world) {
+	Stop();
+	pending.clear();
+	journal.Clear();
+	journalSize = 0;
+
+	std::error_code error;
+	for (auto& entry : std::filesystem::directory_iterator(directory, error)) {
+		auto name = entry.path().filename().string();
+		if (name.rfind("r.", 0) == 0 || name == "journal.bin")
+			std::filesystem::remove(entry.path(), error);
+	}
+	WriteHeader(world.GetGenParams());
+	StartWorker(world.GetGenParams());
+}
+
+void WorldSaver::StartWorker(const WorldGenParams& params) {
+	generator = std::make_unique<WorldGenerator>(params);
+	regions.clear();
+	journalFile = fopen(GetJournalPath().c_str(), "ab");
+	stopping = false;
+	rateWindowStart = std::chrono::steady_clock::now();
+	worker = std::thread(&WorldSaver::WorkerMain, this);
+}
+
+void WorldSaver::Stop() {
+	if (!worker.joinable()) return;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wakeWorker.notify_all();
+	worker.join();
+	if (journalFile) {
+		fclose(journalFile);
+		journalFile = nullptr;
+	}
+}
+
+void WorldSaver::Update(World& world, double time) {
+	if (!worker.joinable()) return;
+
+	for (auto& edit : world.GetEdits())
+		journal.Append(edit);
+	world.GetEdits().clear();
+	if (time - lastJournalSync >= journalSyncInterval)
+		SyncJournal(time);
+	if (journalSize >= (uint64_t)journalCompactSize)
+		Compact(world);
+
+	auto& dirty = world.GetPersistDirtyChunks();
+	for (int chunkIndex : dirty)
+		pending[chunkIndex] = { world.GetChunkByIndex(chunkIndex).GetVersion(), time };
+	dirty.clear();
+
+	for (auto it = pending.begin(); it != pending.end();) {
+		uint32_t version = world.GetChunkByIndex(it->first).GetVersion();
+		if (version != it->second.version) {
+			// edited again during the window: push the deadline back so edits coalesce
+			it->second = { version, time };
+			++it;
+		} else if (time - it->second.lastEdit >= coalesceWindow) {
+			Enqueue(world, it->first);
+			it = pending.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+void WorldSaver::Flush(World& world) {
+	if (!worker.joinable()) return;
+
+	Compact(world);
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [&] { return queue.empty() && journalQueue.empty() && !truncateJournal && !busy; });
+}
+
+void WorldSaver::Compact(World& world) {
+	if (!worker.joinable()) return;
+
+	// these edits are about to be covered by the snapshots below
+	world.GetEdits().clear();
+	journal.Clear();
+
+	for (int chunkIndex : world.GetPersistDirtyChunks())
+		pending[chunkIndex] = {};
+	world.GetPersistDirtyChunks().clear();
+	for (auto& entry : pending)
+		Enqueue(world, entry.first);
+	pending.clear();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		journalQueue.clear();
+		truncateJournal = true;
+		stats.compactions++;
+	}
+	journalSize = 0;
+	wakeWorker.notify_one();
+}
+
+void WorldSaver::SyncJournal(double time) {
+	lastJournalSync = time;
+	if (journal.IsEmpty()) return;
+
+	size_t before;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		before = journalQueue.size();
+		stats.journalEdits += journal.GetCount();
+		journal.SealFrame(journalQueue);
+		journalSize += journalQueue.size() - before;
+	}
+	wakeWorker.notify_one();
+}
+
+void WorldSaver::Enqueue(World& world, int chunkIndex) {
+	Chunk& chunk = world.GetChunkByIndex(chunkIndex);
+	Snapshot snapshot = { chunkIndex, chunk.GetSnapshot(), chunk.GetStates(), std::chrono::steady_clock::now() };
+	chunk.ClearPersistDirty();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queue.push_back(std::move(snapshot));
+	}
+	wakeWorker.notify_one();
+}
+
+void WorldSaver::WorkerMain() {
+	std::vector<Snapshot> batch;
+	std::vector<uint8_t> frames;
+	while (true) {
+		bool truncate;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wakeWorker.wait(lock, [&] { return stopping || !queue.empty() || !journalQueue.empty() || truncateJournal; });
+			if (queue.empty() && journalQueue.empty() && !truncateJournal) break;
+			batch.clear();
+			batch.swap(queue);
+			frames.clear();
+			frames.swap(journalQueue);
+			truncate = truncateJournal;
+			truncateJournal = false;
+			busy = true;
+		}
+
+		// several snapshots of the same chunk collapse into the latest one
+		std::set<int> touchedRegions;
+		uint32_t encoded[2] = {}, reverted = 0;
+		for (auto& snapshot : batch) {
+			RegionPayloads& region = GetRegion(GetRegionIndex(snapshot.chunkIndex));
+			auto& payload = region[GetSlotInRegion(snapshot.chunkIndex)];
+			Encode(snapshot.chunkIndex, snapshot.blocks.GetData(), snapshot.states, payload);
+			if (payload.empty()) reverted++;
+			else encoded[payload[0]]++;
+			touchedRegions.insert(GetRegionIndex(snapshot.chunkIndex));
+		}
+
+		uint64_t bytesWritten = 0;
+		for (int regionIndex : touchedRegions)
+			WriteRegion(regionIndex, regions[regionIndex], bytesWritten);
+
+		// the journal can only be dropped once the regions holding its edits are on disk
+		auto syncStart = std::chrono::steady_clock::now();
+		if (truncate || !frames.empty())
+			WriteJournal(frames, truncate);
+		bytesWritten += frames.size();
+
+		auto now = std::chrono::steady_clock::now();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto& snapshot : batch) {
+				double latency = std::chrono::duration<double, std::milli>(now - snapshot.queuedAt).count();
+				stats.lastLatencyMs = latency;
+				stats.avgLatencyMs = stats.chunksSaved == 0 ? latency : stats.avgLatencyMs * 0.9 + latency * 0.1;
+				stats.chunksSaved++;
+			}
+			stats.totalBytes += bytesWritten;
+			stats.regionsWritten += (uint32_t)touchedRegions.size();
+			stats.fullChunks += encoded[PAYLOAD_FULL];
+			stats.sparseChunks += encoded[PAYLOAD_SPARSE];
+			stats.revertedChunks += reverted;
+			if (truncate || !frames.empty())
+				stats.lastSyncMs = std::chrono::duration<double, std::milli>(now - syncStart).count();
+			rateWindowBytes += bytesWritten;
+			busy = false;
+		}
+		idle.notify_all();
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	busy = false;
+	idle.notify_all();
+}
+
+WorldSaver::RegionPayloads& WorldSaver::GetRegion(int regionIndex) {
+	auto it = regions.find(regionIndex);
+	if (it != regions.end()) return it->second;
+
+	// keep the chunks saved by a previous session, we only rewrite what changed
+	RegionPayloads& region = regions[regionIndex];
+	ReadRegion(GetRegionPath(regionIndex), region);
+	return region;
+}
+
+void WorldSaver::WriteRegion(int regionIndex, const RegionPayloads& payloads, uint64_t& bytesWritten) {
+	std::vector<uint8_t> file;
+	auto pushU32 = [&](uint32_t v) {
+		file.insert(file.end(), reinterpret_cast<uint8_t*>(&v), reinterpret_cast<uint8_t*>(&v) + sizeof(v));
+	};
+
+	pushU32(REGION_MAGIC);
+	pushU32(REGION_FORMAT_VERSION);
+	uint32_t offset = (2 + CHUNKS_PER_REGION * 2) * sizeof(uint32_t);
+	for (auto& payload : payloads) {
+		pushU32(payload.empty() ? 0 : offset);
+		pushU32((uint32_t)payload.size());
+		offset += (uint32_t)payload.size();
+	}
+	for (auto& payload : payloads)
+		file.insert(file.end(), payload.begin(), payload.end());
+
+	// write, sync then rename so a crash mid-write never leaves a truncated region behind
+	std::string path = GetRegionPath(regionIndex);
+	std::string tmpPath = path + ".tmp";
+	{
+		FILE* out = fopen(tmpPath.c_str(), "wb");
+		if (!out) return;
+		bool written = fwrite(file.data(), 1, file.size(), out) == file.size();
+		SyncFile(out);
+		fclose(out);
+		if (!written) return;
+	}
+	std::error_code error;
+	std::filesystem::rename(tmpPath, path, error);
+	if (!error) bytesWritten += file.size();
+}
+
+bool WorldSaver::ReadRegion(const std::string& path, RegionPayloads& out) const {
+	std::ifstream in(path, std::ios::binary | std::ios::ate);
+	if (!in) return false;
+	std::vector<uint8_t> file((size_t)in.tellg());
+	in.seekg(0);
+	in.read(reinterpret_cast<char*>(file.data()), file.size());
+	if (!in) return false;
+
+	const size_t headerSize = (2 + CHUNKS_PER_REGION * 2) * sizeof(uint32_t);
+	if (file.size() < headerSize) return false;
+	const uint32_t* header = reinterpret_cast<const uint32_t*>(file.data());
+	if (header[0] != REGION_MAGIC || header[1] != REGION_FORMAT_VERSION) return false;
+
+	for (int slot = 0; slot < CHUNKS_PER_REGION; slot++) {
+		uint32_t offset = header[2 + slot * 2];
+		uint32_t size = header[2 + slot * 2 + 1];
+		if (size == 0 || (uint64_t)offset + size > file.size()) continue;
+		out[slot].assign(file.begin() + offset, file.begin() + offset + size);
+	}
+	return true;
+}
+
+void WorldSaver::ApplyRegions(World& world) {
+	for (int regionIndex = 0; regionIndex < REGIONS_PER_AXIS * REGIONS_PER_AXIS * REGIONS_PER_AXIS; regionIndex++) {
+		RegionPayloads region;
+		if (!ReadRegion(GetRegionPath(regionIndex), region)) continue;
+
+		int rx = regionIndex % REGIONS_PER_AXIS;
+		int ry = (regionIndex / REGIONS_PER_AXIS) % REGIONS_PER_AXIS;
+		int rz = regionIndex / (REGIONS_PER_AXIS * REGIONS_PER_AXIS);
+		for (int slot = 0; slot < CHUNKS_PER_REGION; slot++) {
+			if (region[slot].empty()) continue;
+			int cx = rx * REGION_SIZE + slot % REGION_SIZE;
+			int cy = ry * REGION_SIZE + (slot / REGION_SIZE) % REGION_SIZE;
+			int cz = rz * REGION_SIZE + slot / (REGION_SIZE * REGION_SIZE);
+			Chunk& chunk = world.GetChunkByIndex(World::GetChunkIndex(cx, cy, cz));
+
+			// the world was just generated so the chunk already holds the reference terrain
+			Chunk::Data data = chunk.GetData();
+			std::vector<Chunk::StateEntry> states;
+			if (!Decode(region[slot], data, states)) continue;
+			chunk.SetData(data);
+			for (const Chunk::StateEntry& entry : states)
+				chunk.SetState(Chunk::Dims::IndexX(entry.index), Chunk::Dims::IndexY(entry.index), Chunk::Dims::IndexZ(entry.index), entry.state);
+		}
+	}
+}
+
+void WorldSaver::WriteJournal(const std::vector<uint8_t>& frames, bool truncate) {
+	if (truncate) {
+		if (journalFile) fclose(journalFile);
+		journalFile = fopen(GetJournalPath().c_str(), "wb");
+	}
+	if (!journalFile) return;
+	if (!frames.empty())
+		fwrite(frames.data(), 1, frames.size(), journalFile);
+	SyncFile(journalFile);
+}
+
+void WorldSaver::ReplayJournal(World& world) {
+	std::ifstream in(GetJournalPath(), std::ios::binary | std::ios::ate);
+	if (!in) return;
+	std::vector<uint8_t> file((size_t)in.tellg());
+	in.seekg(0);
+	in.read(reinterpret_cast<char*>(file.data()), file.size());
+	if (!in) return;
+
+	// everything from the first torn or garbage frame on is cut off, the worker appends after the valid frames
+	std::vector<BlockEdit> edits;
+	size_t valid = EditJournal::Decode(file, edits);
+	if (valid < file.size()) {
+		in.close();
+		std::error_code error;
+		std::filesystem::resize_file(GetJournalPath(), valid, error);
+	}
+	// a frame can pass its checksum and still hold cells of another world size
+	auto outside = std::remove_if(edits.begin(), edits.end(), [&](const BlockEdit& edit) {
+		return !world.ReadCube(edit.gx, edit.gy, edit.gz);
+	});
+	stats.droppedEdits = (uint32_t)(edits.end() - outside);
+	edits.erase(outside, edits.end());
+
+	// the blocks in one batch, ApplyEdits skips the state changes whose block is already there.
+	// Writing a block resets its state so the states come after, in order: the last one of a cell wins
+	world.ApplyEdits(edits);
+	for (auto& edit : edits)
+		world.SetState(edit.gx, edit.gy, edit.gz, edit.state);
+	world.GetEdits().clear();
+	stats.replayedEdits = (uint32_t)edits.size();
+}
+
+void WorldSaver::Encode(int chunkIndex, const Chunk::Data& data, const std::vector<Chunk::StateEntry>& states, std::vector<uint8_t>& out) {
+	int cx, cy, cz;
+	World::GetChunkCoords(chunkIndex, cx, cy, cz);
+	Chunk::Data reference;
+	generator->GenerateChunk(cx, cy, cz, reference);
+
+	uint16_t diffCount = 0;
+	for (size_t i = 0; i < data.size(); i++)
+		if (data[i] != reference[i]) diffCount++;
+
+	out.clear();
+	if (diffCount == 0 && states.empty()) return;
+
+	static thread_local std::vector<uint8_t> rle;
+	Compress(data, rle);
+	size_t sparseSize = sizeof(uint16_t) + diffCount * (sizeof(uint16_t) + sizeof(uint8_t));
+	out.push_back(rle.size() <= sparseSize ? PAYLOAD_FULL : PAYLOAD_SPARSE);
+	out.push_back(states.size() & 0xFF);
+	out.push_back((uint8_t)(states.size() >> 8));
+	for (const Chunk::StateEntry& entry : states) {
+		out.push_back(entry.index & 0xFF);
+		out.push_back(entry.index >> 8);
+		out.push_back(entry.state);
+	}
+	if (out[0] == PAYLOAD_FULL) {
+		out.insert(out.end(), rle.begin(), rle.end());
+		return;
+	}
+
+	out.push_back(diffCount & 0xFF);
+	out.push_back(diffCount >> 8);
+	for (uint16_t i = 0; i < (uint16_t)data.size(); i++) {
+		if (data[i] == reference[i]) continue;
+		out.push_back(i & 0xFF);
+		out.push_back(i >> 8);
+		out.push_back(data[i]);
+	}
+}
+
+bool WorldSaver::Decode(const std::vector<uint8_t>& payload, Chunk::Data& inOut, std::vector<Chunk::StateEntry>& states) {
+	if (payload.size() < 3) return false;
+	size_t stateCount = payload[1] | (payload[2] << 8);
+	const size_t blocks = 3 + stateCount * 3;
+	if (payload.size() < blocks) return false;
+	states.clear();
+	for (size_t i = 0; i < stateCount; i++) {
+		const uint8_t* entry = &payload[3 + i * 3];
+		uint16_t index = entry[0] | (entry[1] << 8);
+		if (index >= inOut.size()) return false;
+		states.push_back({ index, entry[2] });
+	}
+
+	if (payload[0] == PAYLOAD_FULL)
+		return Decompress(payload.data() + blocks, payload.size() - blocks, inOut);
+	if (payload[0] != PAYLOAD_SPARSE || payload.size() < blocks + 2) return false;
+
+	size_t count = payload[blocks] | (payload[blocks + 1] << 8);
+	if (payload.size() != blocks + 2 + count * 3) return false;
+	for (size_t i = 0; i < count; i++) {
+		const uint8_t* entry = &payload[blocks + 2 + i * 3];
+		uint16_t index = entry[0] | (entry[1] << 8);
+		if (index >= inOut.size() || entry[2] >= COUNT) return false;
+		inOut[index] = (BlockId)entry[2];
+	}
+	return true;
+}
+
+bool WorldSaver::ReadHeader(WorldGenParams& params) const {
+	std::ifstream in(directory + "/world.bin", std::ios::binary);
+	if (!in) return false;
+	uint32_t header[3];
+	in.read(reinterpret_cast<char*>(header), sizeof(header));
+	if (!in || header[0] != HEADER_MAGIC || header[1] != HEADER_FORMAT_VERSION || header[2] != sizeof(WorldGenParams)) return false;
+	in.read(reinterpret_cast<char*>(&params), sizeof(params));
+	return (bool)in;
+}
+
+void WorldSaver::WriteHeader(const WorldGenParams& params) const {
+	std::ofstream out(directory + "/world.bin", std::ios::binary | std::ios::trunc);
+	uint32_t header[3] = { HEADER_MAGIC, HEADER_FORMAT_VERSION, sizeof(WorldGenParams) };
+	out.write(reinterpret_cast<const char*>(header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(&params), sizeof(params));
+}
+
+// RLE: (run length, block id) pairs, a chunk is mostly long runs of air / stone
+void WorldSaver::Compress(const Chunk::Data& data, std::vector<uint8_t>& out) {
+	out.clear();
+	for (size_t i = 0; i < data.size();) {
+		size_t run = 1;
+		while (i + run < data.size() && run < 255 && data[i + run] == data[i]) run++;
+		out.push_back((uint8_t)run);
+		out.push_back(data[i]);
+		i += run;
+	}
+}
+
+bool WorldSaver::Decompress(const uint8_t* src, size_t size, Chunk::Data& out) {
+	size_t count = 0;
+	for (size_t i = 0; i + 1 < size; i += 2) {
+		uint8_t run = src[i];
+		BlockId id = (BlockId)src[i + 1];
+		if (count + run > out.size() || id >= COUNT) return false;
+		std::fill_n(out.begin() + count, run, id);
+		count += run;
+	}
+	return count == out.size();
+}
+
+WorldSaver::Stats WorldSaver::GetStats() {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto now = std::chrono::steady_clock::now();
+	double elapsed = std::chrono::duration<double>(now - rateWindowStart).count();
+	if (elapsed >= 1.0) {
+		stats.bytesPerSecond = rateWindowBytes / elapsed;
+		rateWindowBytes = 0;
+		rateWindowStart = now;
+	}
+	stats.pending = (uint32_t)(pending.size() + queue.size());
+	stats.journalBytes = journalSize;
+	return stats;
+}
+
+void WorldSaver::ShowImGui(World& world) {
+	ImGui::Begin("Saver");
+
+	Stats current = GetStats();
+	ImGui::Text("Pending chunks: %u", current.pending);
+	ImGui::Text("Chunks saved: %u (%u region writes)", current.chunksSaved, current.regionsWritten);
+	ImGui::Text("Stored as: %u sparse diffs, %u full, %u back to generated", current.sparseChunks, current.fullChunks, current.revertedChunks);
+	ImGui::Text("Save latency: last %.1f ms, avg %.1f ms", current.lastLatencyMs, current.avgLatencyMs);
+	ImGui::Text("Written: %.1f KB total, %.1f KB/s", current.totalBytes / 1024.0, current.bytesPerSecond / 1024.0);
+	ImGui::Text("Journal: %.1f KB, %u edits, %u compactions, last sync %.2f ms", current.journalBytes / 1024.0, current.journalEdits, current.compactions, current.lastSyncMs);
+	ImGui::Text("Replayed at load: %u edits, %u dropped", current.replayedEdits, current.droppedEdits);
+	ImGui::DragFloat("Coalesce window (s)", &coalesceWindow, 0.05f, 0.0f, 30.0f);
+	ImGui::DragFloat("Journal sync interval (s)", &journalSyncInterval, 0.01f, 0.0f, 5.0f);
+	ImGui::DragInt("Journal compact size", &journalCompactSize, 1024.0f, 1024, 64 * 1024 * 1024);
+
+	if (ImGui::Button("Flush"))
+		Flush(world);
+	ImGui::SameLine();
+	if (ImGui::Button("Compact"))
+		Compact(world);
+
+	ImGui::End();
+}
+
+std::string WorldSaver::GetRegionPath(int regionIndex) const {
+	return directory + "/r." + std::to_string(regionIndex) + ".bin";
+}
+
+int WorldSaver::GetRegionIndex(int chunkIndex) {
+	int cx, cy, cz;
+	World::GetChunkCoords(chunkIndex, cx, cy, cz);
+	return cx / REGION_SIZE + (cy / REGION_SIZE) * REGIONS_PER_AXIS + (cz / REGION_SIZE) * REGIONS_PER_AXIS * REGIONS_PER_AXIS;
+}
+
+int WorldSaver::GetSlotInRegion(int chunkIndex) {
+	int cx, cy, cz;
+	World::GetChunkCoords(chunkIndex, cx, cy, cz);
+	return cx % REGION_SIZE + (cy % REGION_SIZE) * REGION_SIZE + (cz % REGION_SIZE) * REGION_SIZE * REGION_SIZE;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "Chunk.h"
+#include "WorldGenerator.h"
+#include "EditJournal.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+class World;
+
+// Write-behind persistence: edited chunks are snapshotted on the main thread
+// and serialized / compressed / written to region files by a background thread.
+// The terrain itself is never saved: world.bin keeps the generator params and the
+// regions only hold the chunks that differ from what the generator would produce.
+// Every edit is also appended to journal.bin and synced on a short timer, so a crash
+// loses at most journalSyncInterval of edits; compaction folds the journal back into the regions.
+class WorldSaver {
+public:
+	constexpr static int REGION_SIZE = 4; // chunks per axis in one region file
+	constexpr static int CHUNKS_PER_REGION = REGION_SIZE * REGION_SIZE * REGION_SIZE;
+
+	struct Stats {
+		double lastLatencyMs = 0;
+		double avgLatencyMs = 0;
+		double bytesPerSecond = 0;
+		uint64_t totalBytes = 0;
+		uint32_t chunksSaved = 0;
+		uint32_t regionsWritten = 0;
+		uint32_t sparseChunks = 0; // stored as a list of voxel diffs
+		uint32_t fullChunks = 0; // stored as a whole RLE chunk because it was smaller
+		uint32_t revertedChunks = 0; // back to the generated terrain, removed from the save
+		uint32_t pending = 0;
+		uint64_t journalBytes = 0; // since the last compaction
+		uint32_t journalEdits = 0;
+		uint32_t compactions = 0;
+		uint32_t replayedEdits = 0;
+		uint32_t droppedEdits = 0; // journaled outside of the world, skipped by the replay
+		double lastSyncMs = 0;
+	};
+private:
+	struct Snapshot {
+		int chunkIndex;
+		Chunk::Snapshot blocks;
+		std::vector<Chunk::StateEntry> states;
+		std::chrono::steady_clock::time_point queuedAt;
+	};
+	struct Pending {
+		uint32_t version;
+		double lastEdit;
+	};
+	using RegionPayloads = std::array<std::vector<uint8_t>, CHUNKS_PER_REGION>;
+
+	std::string directory;
+	float coalesceWindow = 1.0f; // seconds without edits before a chunk is snapshotted
+	float journalSyncInterval = 0.25f;
+	int journalCompactSize = 256 * 1024; // bytes
+
+	// main thread only
+	std::unordered_map<int, Pending> pending;
+	EditJournal journal;
+	double lastJournalSync = 0;
+	uint64_t journalSize = 0;
+
+	// shared with the worker
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable wakeWorker;
+	std::condition_variable idle;
+	std::vector<Snapshot> queue;
+	std::vector<uint8_t> journalQueue; // sealed frames waiting to be appended
+	bool truncateJournal = false; // set by a compaction, applied once the snapshots queued before it are written
+	bool busy = false;
+	bool stopping = false;
+	Stats stats;
+	// the worker adds what it wrote, GetStats turns it into a rate and restarts the window from the main thread
+	std::chrono::steady_clock::time_point rateWindowStart;
+	uint64_t rateWindowBytes = 0;
+
+	// worker thread only
+	std::unique_ptr<WorldGenerator> generator;
+	std::unordered_map<int, RegionPayloads> regions;
+	FILE* journalFile = nullptr;
+public:
+	WorldSaver() = default;
+	~WorldSaver();
+
+	// loads the save in directory (regenerating the terrain from its params) or starts a new one from the world's params
+	void Open(const std::string& directory, World& world);
+	// drops every saved chunk and restarts from the world's current params (the world must have just been generated)
+	void NewWorld(World& world);
+	void Stop();
+
+	// collects the chunks edited since last frame and snapshots the ones that stayed quiet for coalesceWindow
+	void Update(World& world, double time);
+	// snapshots every pending chunk and blocks until everything is on disk
+	void Flush(World& world);
+	// snapshots every pending chunk and drops the journal once they are written
+	void Compact(World& world);
+
+	Stats GetStats();
+	void ShowImGui(World& world);
+
+	static void Compress(const Chunk::Data& data, std::vector<uint8_t>& out);
+	static bool Decompress(const uint8_t* src, size_t size, Chunk::Data& out);
+private:
+	void StartWorker(const WorldGenParams& params);
+	void Enqueue(World& world, int chunkIndex);
+	void WorkerMain();
+	// returns an empty payload when the chunk matches the generator
+	void Encode(int chunkIndex, const Chunk::Data& data, const std::vector<Chunk::StateEntry>& states, std::vector<uint8_t>& out);
+	static bool Decode(const std::vector<uint8_t>& payload, Chunk::Data& inOut, std::vector<Chunk::StateEntry>& states);
+	void ApplyRegions(World& world);
+	// fills replayedEdits and droppedEdits
+	void ReplayJournal(World& world);
+	void SyncJournal(double time);
+	void WriteJournal(const std::vector<uint8_t>& frames, bool truncate);
+	std::string GetJournalPath() const { return directory + "/journal.bin"; }
+	bool ReadHeader(WorldGenParams& params) const;
+	void WriteHeader(const WorldGenParams& params) const;
+	void WriteRegion(int regionIndex, const RegionPayloads& payloads, uint64_t& bytesWritten);
+	RegionPayloads& GetRegion(int regionIndex);
+	std::string GetRegionPath(int regionIndex) const;
+	bool ReadRegion(const std::string& path, RegionPayloads& out) const;
+
+	static int GetRegionIndex(int chunkIndex);
+	static int GetSlotInRegion(int chunkIndex);
+};